@@ -7,6 +7,8 @@
 
 #include <lumina.h>
 
+#include <algorithm>
+
 // Axis-Aligned Bounding Box Class
 class aabb  {
 public:
@@ -45,26 +47,38 @@ public:
     }
 
     bool hit(const ray& r, interval ray_interval) const {
-        const vec3 ray_origin = r.origin;
-        const vec3 ray_direction = r.direction;
-
-        for (int axis = 0; axis < 3; axis++) {
-            interval axis_of_interest = axis_interval(axis);
-            double inverse_direction = 1.0 / ray_direction[axis];
-            double t0 = (axis_of_interest.min - ray_origin[axis]) * inverse_direction;
-            double t1 = (axis_of_interest.max - ray_origin[axis]) * inverse_direction;
-
-            if (t0 < t1) {
-                if (t0 > ray_interval.min) ray_interval.min = t0;
-                if (t1 < ray_interval.max) ray_interval.max = t1;
-            } else {
-                if (t1 > ray_interval.min) ray_interval.min = t1;
-                if (t0 < ray_interval.max) ray_interval.max = t0;
-            }
-
-            if (ray_interval.min >= ray_interval.max) return false;
-        }
-        return true;
+        return hit(traversal_ray(r), ray_interval);
+    }
+
+    // Branchless slab test: the entry and exit distance of each slab come from min/max instead of a
+    // comparison, and the axes are read directly rather than through axis_interval() or vec3::operator[].
+    // A slab distance is NaN when a direction component is 0 and the origin lies on that slab plane;
+    // traversal_ray makes such a component +0, so the NaN is tx0 on the min plane (tx1 is then +inf) and
+    // tx1 on the max plane (tx0 is then -inf). std::min/std::max return their first argument when either
+    // is NaN, so the operands below are ordered to carry that NaN into the running t_min/t_max as a second
+    // argument, where it is dropped: such an axis leaves the interval unchanged.
+    bool hit(const traversal_ray& r, interval ray_interval) const {
+        real tx0 = (x.min - r.origin.x) * r.inverse_direction.x;
+        real tx1 = (x.max - r.origin.x) * r.inverse_direction.x;
+        real ty0 = (y.min - r.origin.y) * r.inverse_direction.y;
+        real ty1 = (y.max - r.origin.y) * r.inverse_direction.y;
+        real tz0 = (z.min - r.origin.z) * r.inverse_direction.z;
+        real tz1 = (z.max - r.origin.z) * r.inverse_direction.z;
+
+        real t_min = std::max(std::max(std::max(ray_interval.min, std::min(tx0, tx1)), std::min(ty0, ty1)),
+                              std::min(tz0, tz1));
+        real t_max = std::min(std::min(std::min(ray_interval.max, std::max(tx1, tx0)), std::max(ty1, ty0)),
+                              std::max(tz1, tz0));
+        return t_min < t_max;
+    }
+
+    point3 centroid() const {
+        return point3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+    }
+
+    double surface_area() const {
+        double dx = x.size(), dy = y.size(), dz = z.size();
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
     }
 
     int longest_axis() const {
@@ -78,15 +92,12 @@ public:
     static const aabb empty, universe;
 
 private:
-    point3 minimum;
-    point3 maximum;
-
     void pad_to_minimums() {
-        double delta = 0.0001;
+        real delta = 0.0001;
 
-        if (x.size() < delta) x = x.expand(delta);
-        if (y.size() < delta) y = y.expand(delta);
-        if (z.size() < delta) z = z.expand(delta);
+        if (x.size() < delta) x = x.extend(delta);
+        if (y.size() < delta) y = y.extend(delta);
+        if (z.size() < delta) z = z.extend(delta);
     }
 };
 
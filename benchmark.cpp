@@ -0,0 +1,510 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+// lumina_bench: microbenchmarks of the hot routines of the renderer (primitive and box intersection, BVH
+// build and traversal, textures, materials and image output), for tracking performance from commit to
+// commit. All inputs come from fixed seeds, so every run measures exactly the same work.
+//
+// Each benchmark is first calibrated: its batch size is doubled until one batch takes at least --min-time.
+// The batch is then timed --repetitions times and the per-operation times are summarised by their median
+// and median absolute deviation, which a few runs disturbed by the OS do not move, alongside mean,
+// standard deviation and minimum. Results go to stdout as CSV (default) or JSON; progress goes to stderr.
+
+#include <lumina.h>
+
+#include <bvh.h>
+#include <linear_bvh.h>
+#include <color.h>
+#include <framebuffer.h>
+#include <hittable_list.h>
+#include <image_io.h>
+#include <material.h>
+#include <moving_sphere.h>
+#include <perlin.h>
+#include <scene.h>
+#include <sphere.h>
+#include <texture.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct bench_options {
+    std::string format = "csv";
+    std::string filter;
+    int repetitions = 15;
+    // minimum duration of one timed batch, and the time after which a benchmark stops repeating (once it
+    // has at least three samples), in seconds
+    double min_time = 0.02;
+    double max_time = 5.0;
+    long long max_objects = 1000000;
+    bvh_build_options bvh;
+};
+
+struct bench_result {
+    std::string name;
+    // size of the input: objects in the scene, or pixels of the image
+    long long objects;
+    long long iterations;
+    // nanoseconds per operation, one entry per repetition, sorted
+    std::vector<double> samples;
+
+    double median() const { return percentile(samples, 0.5); }
+
+    double median_absolute_deviation() const {
+        double m = median();
+        std::vector<double> deviations;
+        for (double sample : samples) deviations.push_back(std::fabs(sample - m));
+        std::sort(deviations.begin(), deviations.end());
+        return percentile(deviations, 0.5);
+    }
+
+    double mean() const {
+        double sum = 0;
+        for (double sample : samples) sum += sample;
+        return sum / double(samples.size());
+    }
+
+    double stddev() const {
+        if (samples.size() < 2) return 0;
+        double m = mean(), sum = 0;
+        for (double sample : samples) sum += (sample - m) * (sample - m);
+        return std::sqrt(sum / double(samples.size() - 1));
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p) {
+        double position = p * double(sorted.size() - 1);
+        size_t below = size_t(position);
+        size_t above = std::min(below + 1, sorted.size() - 1);
+        return sorted[below] + (position - double(below)) * (sorted[above] - sorted[below]);
+    }
+};
+
+// Results of the measured code are added to this so the compiler cannot drop the work.
+volatile double bench_sink = 0;
+
+inline void keep(double value) { bench_sink = bench_sink + value; }
+
+// Fixed seed for the inputs of one benchmark, derived from its name so that adding or filtering benchmarks
+// does not change the inputs of the others.
+void seed_inputs(const std::string& name) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (char c : name) hash = (hash ^ uint8_t(c)) * 0x100000001B3ull;
+    thread_random_stream().seed(hash, 0);
+}
+
+class bench_runner {
+public:
+    explicit bench_runner(const bench_options& options) : options(options) {}
+
+    bool selected(const std::string& name) const {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    // body(n) performs n operations. teardown, if given, runs after each batch outside the timed region.
+    void run(const std::string& name, long long objects, const std::function<void(long long)>& body,
+             const std::function<void()>& teardown = nullptr) {
+        using clock = std::chrono::steady_clock;
+        auto time_batch = [&](long long iterations) {
+            auto start = clock::now();
+            body(iterations);
+            double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            if (teardown) teardown();
+            return elapsed;
+        };
+
+        // calibration, which doubles as a warm-up
+        long long iterations = 1;
+        double elapsed = time_batch(iterations);
+        while (elapsed < options.min_time && iterations < (1ll << 40)) {
+            double factor = elapsed > 0 ? 1.5 * options.min_time / elapsed : 100.0;
+            iterations = std::max(iterations * 2, (long long)(double(iterations) * std::min(factor, 100.0)));
+            elapsed = time_batch(iterations);
+        }
+
+        bench_result result;
+        result.name = name;
+        result.objects = objects;
+        result.iterations = iterations;
+        double total = 0;
+        for (int r = 0; r < options.repetitions; r++) {
+            if (r >= 3 && total > options.max_time) break;
+            elapsed = time_batch(iterations);
+            total += elapsed;
+            result.samples.push_back(1e9 * elapsed / double(iterations));
+        }
+        std::sort(result.samples.begin(), result.samples.end());
+        std::clog << name << ": " << result.median() << " ns/op (±" << result.median_absolute_deviation() << ")\n";
+        results.push_back(result);
+    }
+
+    void write_csv(std::ostream& out) const {
+        out << "benchmark,objects,iterations,repetitions,median_ns,mad_ns,mean_ns,stddev_ns,min_ns\n";
+        for (const bench_result& result : results) {
+            out << result.name << ',' << result.objects << ',' << result.iterations << ',' << result.samples.size()
+                << ',' << result.median() << ',' << result.median_absolute_deviation() << ',' << result.mean() << ','
+                << result.stddev() << ',' << result.samples.front() << '\n';
+        }
+    }
+
+    void write_json(std::ostream& out) const {
+        out << "{\n  \"context\": {\n"
+            << "    \"real\": \"" << (sizeof(real) == sizeof(float) ? "float" : "double") << "\",\n"
+#ifdef NDEBUG
+            << "    \"optimized\": true,\n"
+#else
+            << "    \"optimized\": false,\n"
+#endif
+#ifdef __AVX2__
+            << "    \"avx2\": true,\n"
+#else
+            << "    \"avx2\": false,\n"
+#endif
+            << "    \"bvh\": \"" << bvh_method_name(options.bvh.method) << "\",\n"
+            << "    \"min_time\": " << options.min_time << ",\n"
+            << "    \"repetitions\": " << options.repetitions << "\n  },\n"
+            << "  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++) {
+            const bench_result& result = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.name << "\", \"objects\": " << result.objects
+                << ", \"iterations\": " << result.iterations << ", \"repetitions\": " << result.samples.size()
+                << ", \"median_ns\": " << result.median() << ", \"mad_ns\": " << result.median_absolute_deviation()
+                << ", \"mean_ns\": " << result.mean() << ", \"stddev_ns\": " << result.stddev()
+                << ", \"min_ns\": " << result.samples.front() << ", \"samples_ns\": [";
+            for (size_t s = 0; s < result.samples.size(); s++) out << (s ? ", " : "") << result.samples[s];
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    static const char* bvh_method_name(bvh_build_method method) {
+        switch (method) {
+            case bvh_build_method::median: return "median";
+            case bvh_build_method::sah: return "sah";
+            default: return "lbvh";
+        }
+    }
+
+private:
+    const bench_options& options;
+    std::vector<bench_result> results;
+};
+
+// Rays pool sizes are powers of two so the benchmarks can cycle through them with a mask.
+const size_t ray_pool_size = 4096;
+
+// Rays starting on a sphere of the given radius around the origin, aimed at random points of the cube of
+// half-size target: some hit a unit object at the origin, some miss it.
+std::vector<ray> make_rays(double radius, double target) {
+    std::vector<ray> rays(ray_pool_size);
+    for (ray& r : rays) {
+        point3 origin = radius * random_unit_vector();
+        point3 aim = vec3::random(-target, target);
+        r = ray(origin, aim - origin, random_double());
+    }
+    return rays;
+}
+
+// A cloud of count unit-density spheres of radius 0.3 in a cube whose volume grows with count.
+hittable_list make_sphere_cloud(long long count, const material* mat) {
+    hittable_list cloud;
+    double half_size = std::cbrt(double(count));
+    for (long long i = 0; i < count; i++) {
+        cloud.add(make_shared<sphere>(vec3::random(-half_size, half_size), 0.3, mat));
+    }
+    return cloud;
+}
+
+void bench_primitives(bench_runner& runner, material_table& materials) {
+    auto mat = materials.make<lambertian>(color3(0.5, 0.5, 0.5));
+
+    if (runner.selected("sphere_hit")) {
+        seed_inputs("sphere_hit");
+        sphere object(point3(0, 0, 0), 1, mat);
+        std::vector<ray> rays = make_rays(5, 1.5);
+        runner.run("sphere_hit", 1, [&](long long n) {
+            hit_record rec;
+            for (long long i = 0; i < n; i++) {
+                if (object.hit(rays[size_t(i) & (ray_pool_size - 1)], interval(0.001, infinity), rec)) keep(rec.root);
+            }
+        });
+    }
+
+    if (runner.selected("moving_sphere_hit")) {
+        seed_inputs("moving_sphere_hit");
+        moving_sphere object(point3(0, 0, 0), point3(0, 0.5, 0), 0, 1, 1, mat);
+        std::vector<ray> rays = make_rays(5, 1.5);
+        runner.run("moving_sphere_hit", 1, [&](long long n) {
+            hit_record rec;
+            for (long long i = 0; i < n; i++) {
+                if (object.hit(rays[size_t(i) & (ray_pool_size - 1)], interval(0.001, infinity), rec)) keep(rec.root);
+            }
+        });
+    }
+
+    aabb box(point3(-1, -1, -1), point3(1, 1, 1));
+    if (runner.selected("aabb_hit")) {
+        seed_inputs("aabb_hit");
+        std::vector<ray> rays = make_rays(5, 1.5);
+        // aabb::hit(ray) computes the inverse direction for every test ...
+        runner.run("aabb_hit", 1, [&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; i++) hits += box.hit(rays[size_t(i) & (ray_pool_size - 1)], interval(0.001, infinity));
+            keep(double(hits));
+        });
+        // ... BVH traversal computes it once per ray
+        std::vector<traversal_ray> traversal_rays;
+        for (const ray& r : rays) traversal_rays.push_back(traversal_ray(r));
+        runner.run("aabb_hit_traversal_ray", 1, [&](long long n) {
+            long long hits = 0;
+            for (long long i = 0; i < n; i++) {
+                hits += box.hit(traversal_rays[size_t(i) & (ray_pool_size - 1)], interval(0.001, infinity));
+            }
+            keep(double(hits));
+        });
+    }
+}
+
+void bench_bvh(bench_runner& runner, const bench_options& options, material_table& materials) {
+    auto mat = materials.make<lambertian>(color3(0.5, 0.5, 0.5));
+    const bool tree_supported = options.bvh.method != bvh_build_method::lbvh;
+    if (!tree_supported) std::clog << "Skipping bvh_node benchmarks: the lbvh builder needs the linear layout.\n";
+
+    for (long long count = 1000; count <= options.max_objects; count *= 10) {
+        const std::string suffix = "/" + std::to_string(count);
+        const bool tree = tree_supported && (runner.selected("bvh_node_build" + suffix)
+                                             || runner.selected("bvh_node_traverse" + suffix));
+        const bool linear = runner.selected("linear_bvh_build" + suffix) || runner.selected("linear_bvh_traverse" + suffix);
+        if (!tree && !linear) continue;
+
+        seed_inputs("sphere_cloud" + suffix);
+        hittable_list cloud = make_sphere_cloud(count, mat);
+        // rays from outside the cloud through it, so traversal cost grows with the size of the cloud
+        double half_size = std::cbrt(double(count));
+        std::vector<ray> rays = make_rays(2 * half_size, half_size);
+
+        auto traverse = [&](const hittable& bvh) {
+            return [&](long long n) {
+                hit_record rec;
+                for (long long i = 0; i < n; i++) {
+                    if (closest_hit(bvh, rays[size_t(i) & (ray_pool_size - 1)], interval(0.001, infinity), rec)) {
+                        keep(rec.root);
+                    }
+                }
+            };
+        };
+
+        if (tree) {
+            std::vector<shared_ptr<bvh_node>> built;
+            if (runner.selected("bvh_node_build" + suffix)) {
+                runner.run("bvh_node_build" + suffix, count,
+                           [&](long long n) { for (long long i = 0; i < n; i++) built.push_back(make_shared<bvh_node>(cloud, options.bvh)); },
+                           [&]() { built.clear(); });
+            }
+            if (runner.selected("bvh_node_traverse" + suffix)) {
+                bvh_node bvh(cloud, options.bvh);
+                runner.run("bvh_node_traverse" + suffix, count, traverse(bvh));
+            }
+        }
+        if (linear) {
+            std::vector<shared_ptr<linear_bvh>> built;
+            if (runner.selected("linear_bvh_build" + suffix)) {
+                runner.run("linear_bvh_build" + suffix, count,
+                           [&](long long n) { for (long long i = 0; i < n; i++) built.push_back(make_shared<linear_bvh>(cloud, options.bvh)); },
+                           [&]() { built.clear(); });
+            }
+            if (runner.selected("linear_bvh_traverse" + suffix)) {
+                linear_bvh bvh(cloud, options.bvh);
+                runner.run("linear_bvh_traverse" + suffix, count, traverse(bvh));
+            }
+        }
+    }
+}
+
+void bench_textures(bench_runner& runner) {
+    if (runner.selected("perlin_turb")) {
+        seed_inputs("perlin_turb");
+        perlin noise;
+        std::vector<point3> points(ray_pool_size);
+        for (point3& p : points) p = vec3::random(-10, 10);
+        runner.run("perlin_turb", 1, [&](long long n) {
+            for (long long i = 0; i < n; i++) keep(noise.turb(points[size_t(i) & (ray_pool_size - 1)], 7));
+        });
+    }
+
+    if (runner.selected("image_texture_value") || runner.selected("image_texture_value_minified")
+        || runner.selected("image_texture_value_coherent")) {
+        seed_inputs("image_texture_value");
+        image_texture earth("earthmap.jpg");
+        // a texture that failed to load returns a constant and would measure nothing
+        const texture_footprint point_sample;
+        if (earth.value(0.5, 0.5, point3(0, 0, 0), point_sample).y == 1.0
+            && earth.value(0.1, 0.9, point3(0, 0, 0), point_sample).y == 1.0) {
+            std::clog << "Skipping image_texture_value: earthmap.jpg was not found (set LUMINA_IMAGES).\n";
+            return;
+        }
+        std::vector<double> uv(2 * ray_pool_size);
+        for (double& coordinate : uv) coordinate = random_double();
+        if (runner.selected("image_texture_value")) {
+            runner.run("image_texture_value", 1, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    size_t k = 2 * (size_t(i) & (ray_pool_size - 1));
+                    keep(earth.value(uv[k], uv[k + 1], point3(0, 0, 0), point_sample).x);
+                }
+            });
+        }
+        // neighbouring lookups, as from the samples of one pixel or adjacent pixels: a random walk in steps of
+        // about a texel
+        std::vector<double> walk(2 * ray_pool_size);
+        double walk_u = 0.5, walk_v = 0.5;
+        for (size_t k = 0; k < walk.size(); k += 2) {
+            walk_u = std::fmod(walk_u + random_double(-1, 1) / 2048 + 1, 1.0);
+            walk_v = std::fmin(std::fmax(walk_v + random_double(-1, 1) / 1024, 0.0), 1.0);
+            walk[k] = walk_u;
+            walk[k + 1] = walk_v;
+        }
+        if (runner.selected("image_texture_value_coherent")) {
+            runner.run("image_texture_value_coherent", 1, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    size_t k = 2 * (size_t(i) & (ray_pool_size - 1));
+                    keep(earth.value(walk[k], walk[k + 1], point3(0, 0, 0), point_sample).x);
+                }
+            });
+        }
+        // a minified texture, as seen by distant rays: lookups go to a small mip level
+        texture_footprint minified;
+        minified.u = minified.v = real(1.0 / 64);
+        if (runner.selected("image_texture_value_minified")) {
+            runner.run("image_texture_value_minified", 1, [&](long long n) {
+                for (long long i = 0; i < n; i++) {
+                    size_t k = 2 * (size_t(i) & (ray_pool_size - 1));
+                    keep(earth.value(uv[k], uv[k + 1], point3(0, 0, 0), minified).x);
+                }
+            });
+        }
+    }
+}
+
+void bench_materials(bench_runner& runner, material_table& materials) {
+    const material* tested[] = {
+        materials.make<lambertian>(color3(0.4, 0.2, 0.1)),
+        materials.make<metal>(color3(0.7, 0.6, 0.5), 0.1),
+        materials.make<dielectric>(1.5),
+    };
+    for (const material* mat : tested) {
+        const std::string name = std::string("scatter_") + material_type_name(mat->type());
+        if (!runner.selected(name)) continue;
+        seed_inputs(name);
+        // surface points of a unit sphere hit from outside
+        sphere object(point3(0, 0, 0), 1, mat);
+        std::vector<ray> rays = make_rays(5, 0.5);
+        std::vector<hit_record> hits(ray_pool_size);
+        for (size_t i = 0; i < ray_pool_size; i++) closest_hit(object, rays[i], interval(0.001, infinity), hits[i]);
+
+        runner.run(name, 1, [&](long long n) {
+            color3 attenuation;
+            ray scattered;
+            for (long long i = 0; i < n; i++) {
+                size_t k = size_t(i) & (ray_pool_size - 1);
+                if (mat->scatter(rays[k], hits[k], attenuation, scattered)) keep(scattered.direction.x);
+            }
+        });
+    }
+}
+
+void bench_output(bench_runner& runner) {
+    seed_inputs("image_output");
+    const int width = 1920, height = 1080;
+    hdr_image image(width, height);
+    // mostly in-range radiance with some highlights above 1
+    for (float& value : image.rgb) value = float(1.5 * random_double() * random_double());
+
+    for (tonemap_operator tonemap : { tonemap_operator::clamp, tonemap_operator::reinhard }) {
+        const std::string name = std::string("display_to_byte_") + (tonemap == tonemap_operator::clamp ? "clamp" : "reinhard");
+        if (!runner.selected(name)) continue;
+        display_transform display;
+        display.tonemap = tonemap;
+        std::vector<uint8_t> bytes(image.rgb.size());
+        // one operation is one channel value
+        runner.run(name, 1, [&](long long n) {
+            size_t size = image.rgb.size(), k = 0;
+            for (long long i = 0; i < n; i++) {
+                bytes[k] = display.to_byte(image.rgb[k]);
+                if (++k == size) k = 0;
+            }
+            keep(bytes[0]);
+        });
+    }
+
+    const long long pixels = (long long)width * height;
+    display_transform display;
+    if (runner.selected("encode_ppm")) {
+        runner.run("encode_ppm", pixels, [&](long long n) {
+            for (long long i = 0; i < n; i++) keep(double(encode_ppm(image, display).size()));
+        });
+    }
+    if (runner.selected("encode_png")) {
+        runner.run("encode_png", pixels, [&](long long n) {
+            for (long long i = 0; i < n; i++) keep(double(encode_png(image, display).size()));
+        });
+    }
+    if (runner.selected("encode_pfm")) {
+        runner.run("encode_pfm", pixels, [&](long long n) {
+            for (long long i = 0; i < n; i++) keep(double(encode_pfm(image).size()));
+        });
+    }
+}
+
+void print_usage(const char* program) {
+    std::cerr << "usage: " << program << " [options]\n"
+              << "  --format csv|json     output format (default: csv)\n"
+              << "  --filter TEXT         only run benchmarks whose name contains TEXT\n"
+              << "  --repetitions N       timed batches per benchmark (default: 15)\n"
+              << "  --min-time SECONDS    minimum duration of one batch (default: 0.02)\n"
+              << "  --max-time SECONDS    stop repeating a benchmark after this long, keeping at least three\n"
+              << "                        batches (default: 5)\n"
+              << "  --max-objects N       largest sphere cloud for the BVH benchmarks, from 1000 up in powers of\n"
+              << "                        ten (default: 1000000; 10000000 needs a few GB of memory)\n"
+              << "  --bvh METHOD          BVH builder: 'sah' (default), 'median' or 'lbvh' (linear_bvh only)\n";
+}
+
+int main(int argc, char* argv[]) {
+    bench_options options;
+    options.bvh.method = bvh_build_method::sah;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        if (option == "--help" || option == "-h" || arg + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++arg];
+        if (option == "--format" && (value == "csv" || value == "json")) options.format = value;
+        else if (option == "--filter") options.filter = value;
+        else if (option == "--repetitions") options.repetitions = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--min-time") options.min_time = std::atof(value.c_str());
+        else if (option == "--max-time") options.max_time = std::atof(value.c_str());
+        else if (option == "--max-objects") options.max_objects = std::atoll(value.c_str());
+        else if (option == "--bvh" && parse_bvh_build_method(value, options.bvh.method)) {}
+        else {
+            std::cerr << "Invalid option '" << option << " " << value << "'.\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bench_runner runner(options);
+    material_table materials;
+    bench_primitives(runner, materials);
+    bench_bvh(runner, options, materials);
+    bench_textures(runner);
+    bench_materials(runner, materials);
+    bench_output(runner);
+
+    if (options.format == "json") runner.write_json(std::cout);
+    else runner.write_csv(std::cout);
+    return 0;
+}
@@ -9,8 +9,280 @@
 #include <aabb.h>
 #include <hittable.h>
 #include <hittable_list.h>
+#include <stats.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class bvh_build_method {
+    median, // sort along the longest axis and split at the median object
+    sah,    // binned surface area heuristic
+    lbvh    // sort by Morton code of the centroids and split at the highest differing bit
+};
+
+inline bool parse_bvh_build_method(const std::string& name, bvh_build_method& method) {
+    if (name == "median") method = bvh_build_method::median;
+    else if (name == "sah") method = bvh_build_method::sah;
+    else if (name == "lbvh") method = bvh_build_method::lbvh;
+    else return false;
+    return true;
+}
+
+struct bvh_build_options {
+    bvh_build_method method = bvh_build_method::median;
+    // number of centroid bins evaluated per split by the SAH builder
+    int sah_bins = 16;
+    // SAH cost of visiting an interior node and of intersecting one primitive
+    double traversal_cost = 1.0;
+    double intersection_cost = 1.0;
+    // the SAH builder keeps up to this many primitives in one leaf when splitting them would cost more
+    int max_leaf_size = 4;
+    // the two subtrees of a node in the top parallel_depth levels are built on separate threads, and
+    // those levels also bin and partition in parallel; 0 builds serially
+    int parallel_depth = 0;
+    // ranges with fewer items than this are always handled on a single thread
+    size_t parallel_threshold = 4096;
+    // depth of the node being built (0 at the root)
+    int depth = 0;
+
+    // spread the build over roughly thread_count threads
+    void set_build_threads(int thread_count) {
+        parallel_depth = 0;
+        while ((1 << parallel_depth) < thread_count) parallel_depth++;
+    }
+
+    bvh_build_options child_options() const {
+        bvh_build_options child = *this;
+        child.parallel_depth = std::max(0, parallel_depth - 1);
+        child.depth = depth + 1;
+        return child;
+    }
+
+    bool parallel_for(size_t span) const { return parallel_depth > 0 && span >= parallel_threshold; }
+};
+
+struct bvh_tree_stats {
+    size_t interior_nodes = 0;
+    size_t leaves = 0;
+    size_t primitives = 0;
+    int max_depth = 0;
+    // expected cost of tracing a ray that hits the root box, in the units of bvh_build_options
+    double sah_cost = 0;
+};
+
+// Run body(chunk, begin, end) for chunk_count contiguous chunks of [start, end), one thread per chunk.
+template <typename Body>
+void bvh_parallel_chunks(size_t start, size_t end, int chunk_count, Body body) {
+    std::vector<std::thread> threads;
+    for (int chunk = 1; chunk < chunk_count; chunk++) {
+        threads.emplace_back(body, chunk, start + (end - start) * chunk / chunk_count,
+                             start + (end - start) * (chunk + 1) / chunk_count);
+    }
+    body(0, start, start + (end - start) / chunk_count);
+    for (auto& thread : threads) thread.join();
+}
+
+// Bounds of the centroids of items [start, end).
+template <typename Item, typename BoxOf>
+aabb bvh_centroid_bounds(const std::vector<Item>& items, size_t start, size_t end, BoxOf box_of,
+                         const bvh_build_options& options) {
+    int chunk_count = options.parallel_for(end - start) ? (1 << options.parallel_depth) : 1;
+    std::vector<aabb> partial(chunk_count, aabb::empty);
+    bvh_parallel_chunks(start, end, chunk_count, [&](int chunk, size_t begin, size_t stop) {
+        aabb bounds = aabb::empty;
+        for (size_t i = begin; i < stop; i++) {
+            point3 c = box_of(items[i]).centroid();
+            bounds = aabb(bounds, aabb(c, c));
+        }
+        partial[chunk] = bounds;
+    });
+    aabb centroid_bounds = aabb::empty;
+    for (const aabb& bounds : partial) centroid_bounds = aabb(centroid_bounds, bounds);
+    return centroid_bounds;
+}
+
+// Binned SAH split of items [start, end). box_of(item) returns an item's bounding box. On return the
+// items are partitioned and the split position is returned; a return value of `end` means that the
+// SAH prefers keeping all items in a single leaf.
+template <typename Item, typename BoxOf>
+size_t bvh_sah_partition(std::vector<Item>& items, size_t start, size_t end, const aabb& bounds,
+                         BoxOf box_of, const bvh_build_options& options) {
+    const size_t span = end - start;
+    const double leaf_cost = options.intersection_cost * double(span);
+    const int chunk_count = options.parallel_for(span) ? (1 << options.parallel_depth) : 1;
+
+    aabb centroid_bounds = bvh_centroid_bounds(items, start, end, box_of, options);
+    int axis = centroid_bounds.longest_axis();
+    interval axis_range = centroid_bounds.axis_interval(axis);
+    // aabb pads degenerate boxes, so a tiny extent means all centroids coincide on every axis
+    if (axis_range.size() <= 0.0001) return span <= size_t(options.max_leaf_size) ? end : start + span / 2;
+
+    struct bin {
+        aabb bbox = aabb::empty;
+        size_t count = 0;
+    };
+    const int bin_count = std::max(2, options.sah_bins);
+    const double bin_scale = bin_count / axis_range.size();
+    auto bin_index = [&](const Item& item) {
+        int b = int((box_of(item).centroid()[axis] - axis_range.min) * bin_scale);
+        return std::min(std::max(b, 0), bin_count - 1);
+    };
+
+    // every chunk fills its own set of bins, which are then merged
+    std::vector<std::vector<bin>> chunk_bins(chunk_count, std::vector<bin>(bin_count));
+    bvh_parallel_chunks(start, end, chunk_count, [&](int chunk, size_t begin, size_t stop) {
+        std::vector<bin>& local = chunk_bins[chunk];
+        for (size_t i = begin; i < stop; i++) {
+            bin& b = local[bin_index(items[i])];
+            b.bbox = aabb(b.bbox, box_of(items[i]));
+            b.count++;
+        }
+    });
+    std::vector<bin> bins = chunk_bins[0];
+    for (int chunk = 1; chunk < chunk_count; chunk++) {
+        for (int b = 0; b < bin_count; b++) {
+            if (chunk_bins[chunk][b].count == 0) continue;
+            bins[b].bbox = aabb(bins[b].bbox, chunk_bins[chunk][b].bbox);
+            bins[b].count += chunk_bins[chunk][b].count;
+        }
+    }
+
+    // sweep from the right to get the area and count of every right-hand side, then from the left
+    std::vector<double> right_area(bin_count, 0.0);
+    std::vector<size_t> right_count(bin_count, 0);
+    aabb accumulated = aabb::empty;
+    size_t count = 0;
+    for (int b = bin_count - 1; b > 0; b--) {
+        if (bins[b].count > 0) accumulated = aabb(accumulated, bins[b].bbox);
+        count += bins[b].count;
+        right_area[b] = count > 0 ? accumulated.surface_area() : 0.0;
+        right_count[b] = count;
+    }
+
+    double parent_area = bounds.surface_area();
+    double best_cost = infinity;
+    int best_split = -1;
+    accumulated = aabb::empty;
+    count = 0;
+    for (int b = 1; b < bin_count; b++) {
+        if (bins[b - 1].count > 0) accumulated = aabb(accumulated, bins[b - 1].bbox);
+        count += bins[b - 1].count;
+        if (count == 0 || right_count[b] == 0) continue;
+        double cost = options.traversal_cost + options.intersection_cost *
+                      (accumulated.surface_area() * count + right_area[b] * right_count[b]) / parent_area;
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_split = b;
+        }
+    }
+
+    if (best_split < 0) return start + span / 2;
+    if (span <= size_t(options.max_leaf_size) && leaf_cost <= best_cost) return end;
+
+    auto goes_left = [&](const Item& item) { return bin_index(item) < best_split; };
+    if (chunk_count == 1) {
+        auto middle = std::partition(items.begin() + start, items.begin() + end, goes_left);
+        return size_t(middle - items.begin());
+    }
+
+    // parallel partition: count the left items of every chunk, then scatter into a scratch array at
+    // offsets given by the prefix sums, and copy back
+    size_t left_total = 0;
+    std::vector<size_t> left_offset(chunk_count), right_offset(chunk_count);
+    for (int chunk = 0; chunk < chunk_count; chunk++) {
+        size_t chunk_left = 0;
+        for (int b = 0; b < best_split; b++) chunk_left += chunk_bins[chunk][b].count;
+        left_offset[chunk] = chunk_left;
+        left_total += chunk_left;
+    }
+
+    size_t left_running = 0, right_running = left_total;
+    for (int chunk = 0; chunk < chunk_count; chunk++) {
+        size_t chunk_size = (span * (chunk + 1) / chunk_count) - (span * chunk / chunk_count);
+        size_t chunk_left = left_offset[chunk];
+        left_offset[chunk] = left_running;
+        right_offset[chunk] = right_running;
+        left_running += chunk_left;
+        right_running += chunk_size - chunk_left;
+    }
+
+    std::vector<Item> scratch(span);
+    bvh_parallel_chunks(start, end, chunk_count, [&](int chunk, size_t begin, size_t stop) {
+        size_t l = left_offset[chunk], r = right_offset[chunk];
+        for (size_t i = begin; i < stop; i++) {
+            if (goes_left(items[i])) scratch[l++] = std::move(items[i]);
+            else scratch[r++] = std::move(items[i]);
+        }
+    });
+    bvh_parallel_chunks(start, end, chunk_count, [&](int, size_t begin, size_t stop) {
+        for (size_t i = begin; i < stop; i++) items[i] = std::move(scratch[i - start]);
+    });
+    return start + left_total;
+}
+
+// 30-bit Morton code of a point inside `bounds`: 10 bits per axis, interleaved as ...zyxzyx.
+inline uint32_t bvh_morton_code(const point3& p, const aabb& bounds) {
+    auto quantise = [](double value, const interval& range) {
+        double t = range.size() > 0 ? (value - range.min) / range.size() : 0.0;
+        uint32_t q = uint32_t(std::min(std::max(t * 1024.0, 0.0), 1023.0));
+        // spread the 10 bits out so that two zero bits separate each of them
+        q = (q | (q << 16)) & 0x030000FF;
+        q = (q | (q << 8)) & 0x0300F00F;
+        q = (q | (q << 4)) & 0x030C30C3;
+        q = (q | (q << 2)) & 0x09249249;
+        return q;
+    };
+    return quantise(p.x, bounds.x) | (quantise(p.y, bounds.y) << 1) | (quantise(p.z, bounds.z) << 2);
+}
+
+// Sort items [start, end) by the Morton code of their centroids and return the sorted codes. Uses an LSD
+// radix sort over (code, index) keys, so the cost is linear in the number of items.
+template <typename Item, typename BoxOf>
+std::vector<uint32_t> bvh_morton_sort(std::vector<Item>& items, size_t start, size_t end, BoxOf box_of,
+                                      const bvh_build_options& options) {
+    const size_t span = end - start;
+    aabb centroid_bounds = bvh_centroid_bounds(items, start, end, box_of, options);
+    int chunk_count = options.parallel_for(span) ? (1 << options.parallel_depth) : 1;
+
+    std::vector<uint64_t> keys(span), scratch(span);
+    bvh_parallel_chunks(start, end, chunk_count, [&](int, size_t begin, size_t stop) {
+        for (size_t i = begin; i < stop; i++)
+            keys[i - start] = (uint64_t(bvh_morton_code(box_of(items[i]).centroid(), centroid_bounds)) << 32) | (i - start);
+    });
+    // only the 30 code bits need sorting; the index in the low word just rides along
+    for (int shift = 32; shift < 62; shift += 10) {
+        size_t counts[1025] = {};
+        for (uint64_t key : keys) counts[((key >> shift) & 1023) + 1]++;
+        for (int d = 0; d < 1024; d++) counts[d + 1] += counts[d];
+        for (uint64_t key : keys) scratch[counts[(key >> shift) & 1023]++] = key;
+        keys.swap(scratch);
+    }
+
+    std::vector<Item> sorted(span);
+    std::vector<uint32_t> codes(span);
+    for (size_t i = 0; i < span; i++) {
+        sorted[i] = std::move(items[start + (keys[i] & 0xFFFFFFFF)]);
+        codes[i] = uint32_t(keys[i] >> 32);
+    }
+    std::move(sorted.begin(), sorted.end(), items.begin() + start);
+    return codes;
+}
+
+// Split position for Morton-sorted codes [start, end): the first index at which the highest bit that
+// differs across the range is set. Falls back to the middle if all codes in the range are equal.
+inline size_t bvh_morton_split(const std::vector<uint32_t>& codes, size_t start, size_t end) {
+    uint32_t first = codes[start], last = codes[end - 1];
+    if (first == last) return start + (end - start) / 2;
+    int highest_bit = 31;
+    while (!(((first ^ last) >> highest_bit) & 1)) highest_bit--;
+    // binary search for the first code that has the differing bit set
+    uint32_t prefix_mask = ~((1u << highest_bit) - 1);
+    uint32_t split_code = (first & prefix_mask) | (1u << highest_bit);
+    return size_t(std::lower_bound(codes.begin() + start, codes.begin() + end, split_code) - codes.begin());
+}
 
 class bvh_node : public hittable {
 public:
@@ -21,16 +293,16 @@ public:
         // persist the resulting bounding volume hierarchy.
     }
 
-    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) {
+    bvh_node(hittable_list list, const bvh_build_options& options)
+        : bvh_node(list.objects, 0, list.objects.size(), options) {}
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+             const bvh_build_options& options = bvh_build_options()) {
         // Instead of using random axis to split, compute the longest axis and split along that
         bbox = aabb::empty;
         for (size_t object_index=start; object_index < end; object_index++)
             bbox = aabb(bbox, objects[object_index] -> bounding_box());
 
-        int axis = bbox.longest_axis();
-        // int axis = random_int(0, 2);
-        auto comparator = (axis == 0) ? box_x_compare : (axis == 1) ? box_y_compare : box_z_compare;
-
         size_t object_span = end - start;
 
         if (object_span == 1) {
@@ -39,29 +311,127 @@ public:
             left = objects[start];
             right = objects[start + 1];
         } else {
-            std::sort(std::begin(objects) + start, std::begin(objects) + end, comparator);
+            size_t mid;
+            if (options.method == bvh_build_method::sah) {
+                mid = bvh_sah_partition(objects, start, end, bbox,
+                                        [](const shared_ptr<hittable>& object) { return object->bounding_box(); },
+                                        options);
+                if (mid == end) {
+                    // the SAH prefers a leaf: keep the objects together in a plain list
+                    auto leaf = make_shared<hittable_list>();
+                    for (size_t object_index = start; object_index < end; object_index++) leaf->add(objects[object_index]);
+                    left = right = leaf;
+                    return;
+                }
+            } else {
+                // Morton ordering needs the whole object range up front, so the node-by-node tree builder
+                // treats lbvh like median; linear_bvh implements it properly
+                int axis = bbox.longest_axis();
+                // int axis = random_int(0, 2);
+                auto comparator = (axis == 0) ? box_x_compare : (axis == 1) ? box_y_compare : box_z_compare;
+                std::sort(std::begin(objects) + start, std::begin(objects) + end, comparator);
+                mid = start + object_span / 2;
+            }
 
-            auto mid = start + object_span / 2;
-            left = make_shared<bvh_node>(objects, start, mid);
-            right = make_shared<bvh_node>(objects, mid, end);
+            bvh_build_options child_options = options.child_options();
+            if (options.parallel_for(object_span)) {
+                // the two halves are disjoint ranges of `objects`, so they can be built concurrently
+                std::thread left_builder([&] { left = make_shared<bvh_node>(objects, start, mid, child_options); });
+                right = make_shared<bvh_node>(objects, mid, end, child_options);
+                left_builder.join();
+            } else {
+                left = make_shared<bvh_node>(objects, start, mid, child_options);
+                right = make_shared<bvh_node>(objects, mid, end, child_options);
+            }
         }
 
+        prepare_traversal();
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
-        if (!bbox.hit(r, ray_t)) return false;
-        bool hit_left = left->hit(r, ray_t, rec);
-        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.root : ray_t.max), rec);
-
-        return hit_left || hit_right;
+        // the inverse direction is computed once here and shared by every box below this node
+        return hit_node(r, traversal_ray(r), ray_t, rec);
     }
 
     aabb bounding_box() const override { return bbox; }
 
+    // Shape of the tree and its SAH cost, using the cost constants of the given options.
+    bvh_tree_stats stats(const bvh_build_options& options = bvh_build_options()) const {
+        bvh_tree_stats result;
+        collect_stats(result, 1, bbox.surface_area(), options);
+        return result;
+    }
+
 private:
     shared_ptr<hittable> left;
     shared_ptr<hittable> right;
     aabb bbox;
+    // children that are bvh_nodes are descended into directly, without a virtual hit() call and without
+    // rebuilding the traversal_ray
+    bool left_is_node = false;
+    bool right_is_node = false;
+    // axis along which the left child lies below the right one; rays heading down it visit the right child first
+    int split_axis = 0;
+
+    void prepare_traversal() {
+        left_is_node = dynamic_cast<const bvh_node*>(left.get()) != nullptr;
+        right_is_node = dynamic_cast<const bvh_node*>(right.get()) != nullptr;
+        if (left == right) return;
+        vec3 gap = right->bounding_box().centroid() - left->bounding_box().centroid();
+        double ax = std::fabs(gap.x), ay = std::fabs(gap.y), az = std::fabs(gap.z);
+        split_axis = (ax >= ay && ax >= az) ? 0 : (ay >= az ? 1 : 2);
+        if (gap[split_axis] < 0) {
+            std::swap(left, right);
+            std::swap(left_is_node, right_is_node);
+        }
+    }
+
+    bool hit_node(const ray& r, const traversal_ray& tr, interval ray_t, hit_record& rec) const {
+        LUMINA_COUNT(bvh_nodes_visited);
+        LUMINA_COUNT(aabb_tests);
+        if (!bbox.hit(tr, ray_t)) return false;
+        // single-child leaves store the same object on both sides
+        if (left == right) return hit_child(left.get(), left_is_node, r, tr, ray_t, rec);
+
+        bool right_first = tr.sign[split_axis] != 0;
+        const hittable* first = right_first ? right.get() : left.get();
+        const hittable* second = right_first ? left.get() : right.get();
+        bool first_is_node = right_first ? right_is_node : left_is_node;
+        bool second_is_node = right_first ? left_is_node : right_is_node;
+
+        bool hit_first = hit_child(first, first_is_node, r, tr, ray_t, rec);
+        bool hit_second = hit_child(second, second_is_node, r, tr,
+                                    interval(ray_t.min, hit_first ? rec.root : ray_t.max), rec);
+        return hit_first || hit_second;
+    }
+
+    static bool hit_child(const hittable* child, bool is_node, const ray& r, const traversal_ray& tr,
+                          interval ray_t, hit_record& rec) {
+        if (is_node) return static_cast<const bvh_node*>(child)->hit_node(r, tr, ray_t, rec);
+        return child->hit(r, ray_t, rec);
+    }
+
+    void collect_stats(bvh_tree_stats& result, int depth, double root_area, const bvh_build_options& options) const {
+        result.interior_nodes++;
+        result.max_depth = std::max(result.max_depth, depth);
+        result.sah_cost += options.traversal_cost * bbox.surface_area() / root_area;
+        collect_child_stats(left, result, depth + 1, root_area, options);
+        if (right != left) collect_child_stats(right, result, depth + 1, root_area, options);
+    }
+
+    static void collect_child_stats(const shared_ptr<hittable>& child, bvh_tree_stats& result, int depth,
+                                    double root_area, const bvh_build_options& options) {
+        if (auto node = dynamic_cast<const bvh_node*>(child.get())) {
+            node->collect_stats(result, depth, root_area, options);
+            return;
+        }
+        auto list = dynamic_cast<const hittable_list*>(child.get());
+        size_t count = list ? list->objects.size() : 1;
+        result.leaves++;
+        result.primitives += count;
+        result.max_depth = std::max(result.max_depth, depth);
+        result.sah_cost += options.intersection_cost * double(count) * child->bounding_box().surface_area() / root_area;
+    }
 
     static bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index) {
         auto a_axis_interval = a->bounding_box().axis_interval(axis_index);
@@ -14,6 +14,7 @@ public:
         auto h = tan(theta / 2);
         auto viewport_height = 2.0 * h;
         auto viewport_width = aspect_ratio * viewport_height;
+        this->viewport_height = viewport_height;
 
         open_time = shutter_time.min;
         close_time = shutter_time.max;
@@ -40,6 +41,10 @@ public:
         return ray(o, d, random_double(open_time, close_time));
     }
 
+    // Angle between the rays through the centres of vertically adjacent pixels, near the image centre, for
+    // an image image_height pixels high.
+    double pixel_spread(int image_height) const { return viewport_height / (image_height - 1); }
+
 private:
     int image_width;
     int image_height;
@@ -51,8 +56,38 @@ private:
     vec3 vertical;
     vec3 u, v, w;
     double lens_radius;
+    // height of the image plane at unit distance
+    double viewport_height;
     double open_time;
     double close_time;
 };
 
+// Placement and lens of a scene's camera; the defaults are the view of the book scenes.
+struct camera_settings {
+    point3 lookfrom = point3(13, 2, 3);
+    point3 lookat = point3(0, 0, 0);
+    vec3 upwards = vec3(0, 1, 0);
+    // vertical field of view in degrees
+    double v_fov = 20;
+    double aspect_ratio = 16.0 / 9.0;
+    double aperture = 0.1;
+    double focus_distance = 10.0;
+    interval shutter_time = interval(0.0, 1.0);
+
+    camera make_camera() const {
+        return camera(lookfrom, lookat, upwards, v_fov, aspect_ratio, aperture, focus_distance, shutter_time);
+    }
+};
+
+// Camera ray for one anti-aliasing sample of pixel (i, j), with j counting rows from the bottom of the
+// image. The caller is expected to have seeded the thread's random stream for this (pixel, sample). With
+// texture level of detail on, the ray carries the cone of its pixel (see ray.h).
+inline ray camera_sample_ray(const camera& cam, int i, int j, int image_width, int image_height) {
+    auto u = (i + random_double()) / (image_width - 1);
+    auto v = (j + random_double()) / (image_height - 1);
+    ray r = cam.get_ray(u, v);
+    if (texture_lod_mode()) r.cone_spread = real(cam.pixel_spread(image_height));
+    return r;
+}
+
 #endif //LUMINA_CAMERA_H
@@ -0,0 +1,156 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_CHECKPOINT_H
+#define LUMINA_CHECKPOINT_H
+
+#include <lumina.h>
+#include <framebuffer.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// What a checkpoint records besides the pixels. The random streams are counter-based (see random_stream),
+// so the seed and each pixel's sample count are the complete RNG state: resuming draws exactly the samples
+// an uninterrupted render would have drawn next.
+struct checkpoint_info {
+    int width = 0;
+    int height = 0;
+    uint64_t seed = 0;
+    // set for the sum of several checkpoints, which mixes seeds and so cannot be resumed
+    bool merged = false;
+    // description of everything that determines the image (renderer version, scene, integrator, ...);
+    // checkpoints are only resumed or merged when it matches exactly
+    std::string config;
+};
+
+// Version of what the renderer draws. Bump it with every change that alters the image of a given
+// configuration (an intersection fix, a changed built-in scene, ...): it is part of a checkpoint's config,
+// so checkpoints and references from before the change are rejected instead of mixed with new samples.
+const int renderer_version = 1;
+
+// File layout, in native byte order:
+//   "LUMCKPT" NUL, uint32 version, uint32 flags, int32 width, int32 height, uint64 seed,
+//   uint32 config length, config bytes,
+//   width * height pixel records of 36 bytes (see checkpoint_put_pixel), in framebuffer order.
+const char checkpoint_magic[8] = { 'L', 'U', 'M', 'C', 'K', 'P', 'T', 0 };
+const uint32_t checkpoint_version = 1;
+const uint32_t checkpoint_flag_merged = 1;
+const size_t checkpoint_pixel_bytes = 4 * sizeof(double) + sizeof(uint32_t);
+
+template <typename T>
+inline void checkpoint_put(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+inline bool checkpoint_get(const std::vector<uint8_t>& in, size_t& offset, T& value) {
+    if (offset > in.size() || in.size() - offset < sizeof(T)) return false;
+    std::memcpy(&value, in.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+// One pixel record: double sum[3], double luminance_sq_sum, uint32 sample_count.
+inline void checkpoint_put_pixel(std::vector<uint8_t>& out, const pixel_accumulator& p) {
+    checkpoint_put(out, p.sum[0]);
+    checkpoint_put(out, p.sum[1]);
+    checkpoint_put(out, p.sum[2]);
+    checkpoint_put(out, p.luminance_sq_sum);
+    checkpoint_put(out, uint32_t(p.sample_count));
+}
+
+inline bool checkpoint_get_pixel(const std::vector<uint8_t>& in, size_t& offset, pixel_accumulator& p) {
+    if (offset > in.size() || in.size() - offset < checkpoint_pixel_bytes) return false;
+    double sum[3] = { 0, 0, 0 };
+    double luminance_sq_sum = 0;
+    uint32_t sample_count = 0;
+    if (!checkpoint_get(in, offset, sum[0]) || !checkpoint_get(in, offset, sum[1]) || !checkpoint_get(in, offset, sum[2])
+        || !checkpoint_get(in, offset, luminance_sq_sum) || !checkpoint_get(in, offset, sample_count)) {
+        return false;
+    }
+    for (int c = 0; c < 3; c++) p.sum[c] = sum[c];
+    p.luminance_sq_sum = luminance_sq_sum;
+    p.sample_count = int(sample_count);
+    return true;
+}
+
+// Writes the accumulators of image to path. The data goes to a temporary file first that then replaces
+// path, so an interruption while saving leaves the previous checkpoint intact.
+inline bool save_checkpoint(const std::string& path, const framebuffer& image, const checkpoint_info& info) {
+    std::vector<uint8_t> out;
+    out.reserve(64 + info.config.size() + size_t(image.width()) * image.height() * checkpoint_pixel_bytes);
+    out.insert(out.end(), checkpoint_magic, checkpoint_magic + 8);
+    checkpoint_put(out, checkpoint_version);
+    checkpoint_put(out, info.merged ? checkpoint_flag_merged : uint32_t(0));
+    checkpoint_put(out, int32_t(image.width()));
+    checkpoint_put(out, int32_t(image.height()));
+    checkpoint_put(out, info.seed);
+    checkpoint_put(out, uint32_t(info.config.size()));
+    out.insert(out.end(), info.config.begin(), info.config.end());
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++) checkpoint_put_pixel(out, image.pixel(x, y));
+    }
+
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(out.data()), std::streamsize(out.size()));
+        if (!file) {
+            std::cerr << "Could not write checkpoint '" << temporary_path << "'.\n";
+            return false;
+        }
+    }
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not replace checkpoint '" << path << "'.\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads a checkpoint written by save_checkpoint into image (resized to match) and info.
+inline bool load_checkpoint(const std::string& path, framebuffer& image, checkpoint_info& info) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not open checkpoint '" << path << "'.\n";
+        return false;
+    }
+    std::vector<uint8_t> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t offset = 0;
+    uint32_t version = 0, flags = 0, config_size = 0;
+    int32_t width = 0, height = 0;
+    bool valid = in.size() >= 8 && std::memcmp(in.data(), checkpoint_magic, 8) == 0;
+    offset = 8;
+    valid = valid && checkpoint_get(in, offset, version) && version == checkpoint_version
+            && checkpoint_get(in, offset, flags) && checkpoint_get(in, offset, width)
+            && checkpoint_get(in, offset, height) && checkpoint_get(in, offset, info.seed)
+            && checkpoint_get(in, offset, config_size) && width > 0 && height > 0
+            && in.size() - offset >= config_size;
+    if (valid) {
+        info.config.assign(reinterpret_cast<const char*>(in.data() + offset), config_size);
+        offset += config_size;
+        valid = in.size() - offset == size_t(width) * height * checkpoint_pixel_bytes;
+    }
+    if (!valid) {
+        std::cerr << "'" << path << "' is not a Lumina checkpoint (or is truncated or from another version).\n";
+        return false;
+    }
+    info.width = width;
+    info.height = height;
+    info.merged = (flags & checkpoint_flag_merged) != 0;
+
+    image = framebuffer(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) checkpoint_get_pixel(in, offset, image.pixel(x, y));
+    }
+    return true;
+}
+
+#endif //LUMINA_CHECKPOINT_H
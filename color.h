@@ -8,21 +8,28 @@
 #include <lumina.h>
 #include <vec3.h>
 
-void write_color(std::ostream &os, color3 pixel_color, int samples_per_pixel)    {
-    auto r = pixel_color.x;
-    auto g = pixel_color.y;
-    auto b = pixel_color.z;
-
-    // Divide color values by the number of samples + color correct using gamma = 2.0
-    auto scale = 1.0 / samples_per_pixel;
-    r = sqrt(scale * r);
-    g = sqrt(scale * g);
-    b = sqrt(scale * b);
-
-    // Write [0, 255] value of each color component
-    os << static_cast<int>(255.999 * clamp(r, 0.0, 0.999)) << " "
-       << static_cast<int>(255.999 * clamp(g, 0.0, 0.999)) << " "
-       << static_cast<int>(255.999 * clamp(b, 0.0, 0.999)) << "\n";
-}
+#include <cstdint>
+
+enum class tonemap_operator { clamp, reinhard };
+
+// Mapping from linear radiance to 8-bit display values, applied once per pixel when an image is written.
+// The display curve is gamma 2.0 (a square root), as it has always been. Written without branches so that
+// loops converting whole rows vectorise.
+struct display_transform {
+    tonemap_operator tonemap = tonemap_operator::clamp;
+
+    // display value in [0, 0.999]
+    float encode(float linear) const {
+        linear = linear > 0.0f ? linear : 0.0f;
+        float mapped = tonemap == tonemap_operator::reinhard ? linear / (1.0f + linear) : linear;
+        float encoded = std::sqrt(mapped);
+        return encoded < 0.999f ? encoded : 0.999f;
+    }
+
+    uint8_t to_byte(float linear) const {
+        // Write [0, 255] value of each color component
+        return static_cast<uint8_t>(255.999f * encode(linear));
+    }
+};
 
 #endif //LUMINA_COLOR_H
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# Created by Anchit Mishra on 2026-10-18.
+#
+# Renders every shipped scene with the double (Lumina) and float (Lumina_float) builds and reports the
+# render time of each and the RMSE between the two images, in 8-bit levels.
+#
+# usage: ./compare_precision.sh [build directory] [extra Lumina options...]
+# e.g.   ./compare_precision.sh build --width 400 --spp 16
+
+build_dir=${1:-build}
+[ $# -gt 0 ] && shift
+options=${*:---width 400 --spp 16}
+scenes="cover_scene_book_one bouncing_balls_with_texture checkered_spheres textured_globe perlin_spheres particle_cloud"
+
+for binary in Lumina Lumina_float; do
+    if [ ! -x "$build_dir/$binary" ]; then
+        echo "$build_dir/$binary not found; build both targets first" >&2
+        exit 1
+    fi
+done
+build_dir=$(cd "$build_dir" && pwd)
+
+work_dir=$(mktemp -d)
+trap 'rm -rf "$work_dir"' EXIT
+
+# render time in seconds, as printed by Lumina
+render() {
+    (cd "$work_dir" && "$build_dir/$1" --scene "$2" $options 2>&1 | tr '\r' '\n' \
+        | sed -n 's/^Render time: \([0-9.e+-]*\) s$/\1/p'
+     mv "$work_dir/motion_blur.ppm" "$work_dir/$1.ppm")
+}
+
+# channel values of a binary (P6) PPM, one per line; the header is the first three lines
+channels() {
+    tail -n +4 "$1" | od -An -v -tu1
+}
+
+# RMSE over all channel values of two images of the same size
+rmse() {
+    channels "$1" > "$1.txt"
+    channels "$2" > "$2.txt"
+    awk 'FNR == NR { for (i = 1; i <= NF; i++) a[++n] = $i; next }
+         { for (i = 1; i <= NF; i++) { d = $i - a[++m]; s += d * d } }
+         END { printf "%.3f", (m > 0 ? sqrt(s / m) : 0) }' "$1.txt" "$2.txt"
+}
+
+printf "%-30s %12s %12s %8s %10s\n" scene "double (s)" "float (s)" speedup "RMSE"
+for scene in $scenes; do
+    double_time=$(render Lumina "$scene")
+    float_time=$(render Lumina_float "$scene")
+    error=$(rmse "$work_dir/Lumina.ppm" "$work_dir/Lumina_float.ppm")
+    speedup=$(awk -v d="$double_time" -v f="$float_time" 'BEGIN { printf "%.2f", (f > 0 ? d / f : 0) }')
+    printf "%-30s %12s %12s %8s %10s\n" "$scene" "$double_time" "$float_time" "$speedup" "$error"
+done
@@ -0,0 +1,383 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_DISTRIBUTED_H
+#define LUMINA_DISTRIBUTED_H
+
+#include <lumina.h>
+#include <camera.h>
+#include <checkpoint.h>
+#include <framebuffer.h>
+#include <hittable.h>
+#include <renderer.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LUMINA_HAS_DISTRIBUTED 1
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Multi-process rendering of one frame. The coordinator starts worker processes (Lumina itself with
+// --worker and the same scene options), each of which rebuilds the scene and then renders the tiles it is
+// sent, one at a time. Workers talk to the coordinator over their stdin and stdout, so any command that
+// connects those streams to a worker (a remote shell, for instance) can carry the same protocol.
+//
+// Protocol, in native byte order:
+//   worker -> coordinator   uint64 scene fingerprint, once at start-up
+//   coordinator -> worker   int32 tile index to render, or -1 to exit
+//   worker -> coordinator   int32 tile index, then one pixel record per pixel of the tile, row by row
+//                           (see checkpoint_put_pixel)
+// A tile is rendered by exactly one process from its first to its last sample, so the image is
+// bit-identical to a single-process render. When a worker exits or its pipe breaks, or takes far longer
+// over a tile than tiles usually take, it is killed, its tile is handed out again and a replacement worker
+// is started.
+
+// FNV-1a hash of the parts of the scene that every worker must agree on.
+inline uint64_t scene_fingerprint(const std::string& config, const hittable& world, size_t object_count) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    };
+    add(config.data(), config.size());
+    add(&object_count, sizeof(object_count));
+    aabb bounds = world.bounding_box();
+    for (int axis = 0; axis < 3; axis++) {
+        interval range = bounds.axis_interval(axis);
+        double limits[2] = { double(range.min), double(range.max) };
+        add(limits, sizeof(limits));
+    }
+    return hash;
+}
+
+#ifdef LUMINA_HAS_DISTRIBUTED
+
+typedef std::chrono::steady_clock::time_point worker_deadline;
+
+const worker_deadline no_deadline = worker_deadline::max();
+
+// A worker that spends worker_timeout_factor times the median tile time on a tile (and at least
+// worker_timeout_minimum seconds) is taken to hang, as is one that spends that many times the start-up time
+// of the first worker on starting up. Each timeout of a tile doubles the time allowed for it, so that a tile
+// that is merely slow is not given up on.
+const double worker_timeout_factor = 10;
+const double worker_timeout_minimum = 5;
+
+// poll() timeout in milliseconds until deadline, rounded up; -1 (wait indefinitely) for no_deadline.
+inline int poll_timeout(worker_deadline deadline) {
+    if (deadline == no_deadline) return -1;
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return int(std::min<long long>(std::max<long long>(remaining.count() + 1, 0), 1 << 30));
+}
+
+// Reads size bytes, giving up if the stream ends or, unless deadline is no_deadline, at the deadline.
+inline bool read_exact(int fd, void* data, size_t size, worker_deadline deadline = no_deadline) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        if (deadline != no_deadline) {
+            pollfd readable = { fd, POLLIN, 0 };
+            int ready = ::poll(&readable, 1, poll_timeout(deadline));
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+        }
+        ssize_t n = ::read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+inline bool write_exact(int fd, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, bytes, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+// Worker side: announce the scene fingerprint, then render tiles until told to stop or the coordinator
+// goes away. Returns the process exit code.
+inline int run_render_worker(const hittable& world, const camera& cam, renderer& tile_renderer, framebuffer& image,
+                             uint64_t fingerprint) {
+    const int in = STDIN_FILENO, out = STDOUT_FILENO;
+    if (!write_exact(out, &fingerprint, sizeof(fingerprint))) return 1;
+    std::vector<uint8_t> message;
+    while (true) {
+        int32_t tile_index;
+        if (!read_exact(in, &tile_index, sizeof(tile_index))) return 1;
+        if (tile_index < 0) return 0;
+        if (tile_index >= tile_renderer.tile_count()) return 1;
+        tile_renderer.render_single_tile(world, cam, image, tile_index);
+
+        int x0, y0, x1, y1;
+        tile_renderer.grid().bounds(tile_index, x0, y0, x1, y1);
+        message.clear();
+        checkpoint_put(message, tile_index);
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) checkpoint_put_pixel(message, image.pixel(x, y));
+        }
+        if (!write_exact(out, message.data(), message.size())) return 1;
+    }
+}
+
+// Coordinator side: hands the tiles of grid out to worker_count worker processes started from
+// worker_command and collects the results into image.
+class render_coordinator {
+public:
+    render_coordinator(std::vector<std::string> worker_command, int worker_count)
+        : command(std::move(worker_command)), worker_count(worker_count) {}
+
+    // Returns false (after printing the reason) if the workers disagree about the scene, or if workers keep
+    // failing so that the frame cannot be finished.
+    bool render(const tile_grid& grid, framebuffer& image) {
+        // a write to a worker that has just died must fail instead of killing the coordinator
+        std::signal(SIGPIPE, SIG_IGN);
+        std::deque<int> pending;
+        for (int tile = 0; tile < grid.count(); tile++) pending.push_back(tile);
+        std::vector<int> failures(grid.count(), 0);
+        int tiles_remaining = grid.count();
+        int restarts_left = 2 * worker_count;
+        bool have_fingerprint = false;
+        uint64_t fingerprint = 0;
+        // time allowed for start-up, known once the first worker is up, and seconds taken by finished tiles
+        double startup_allowance = -1;
+        std::vector<double> tile_seconds;
+        double median_tile_seconds = -1;
+
+        workers.clear();
+        for (int i = 0; i < worker_count; i++) {
+            if (!start_worker()) return stop_all(false);
+        }
+        std::vector<uint8_t> message;
+        while (tiles_remaining > 0) {
+            // hand out tiles to idle workers
+            for (worker_process& worker : workers) {
+                if (worker.ready && worker.tile < 0 && !pending.empty()) {
+                    int32_t tile = pending.front();
+                    if (write_exact(worker.to_worker, &tile, sizeof(tile))) {
+                        pending.pop_front();
+                        worker.tile = tile;
+                        worker.started = std::chrono::steady_clock::now();
+                    }
+                }
+            }
+
+            // the earliest deadline of a worker bounds the wait
+            std::vector<worker_deadline> deadlines(workers.size(), no_deadline);
+            worker_deadline earliest = no_deadline;
+            for (size_t i = 0; i < workers.size(); i++) {
+                const worker_process& worker = workers[i];
+                if (!worker.ready && startup_allowance >= 0) {
+                    deadlines[i] = deadline_after(worker.started, startup_allowance);
+                } else if (worker.ready && worker.tile >= 0 && median_tile_seconds >= 0) {
+                    double allowance = std::max(worker_timeout_factor * median_tile_seconds, worker_timeout_minimum);
+                    deadlines[i] = deadline_after(worker.started, allowance * double(1 << failures[worker.tile]));
+                }
+                earliest = std::min(earliest, deadlines[i]);
+            }
+
+            std::vector<pollfd> polled(workers.size());
+            for (size_t i = 0; i < workers.size(); i++) polled[i] = { workers[i].from_worker, POLLIN, 0 };
+            if (::poll(polled.data(), nfds_t(polled.size()), poll_timeout(earliest)) < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "poll() failed while waiting for workers.\n";
+                return stop_all(false);
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < workers.size(); i++) {
+                worker_process& worker = workers[i];
+                // silent past its deadline: the worker hangs rather than exits, and is treated as lost
+                bool timed_out = polled[i].revents == 0 && now >= deadlines[i];
+                if (polled[i].revents == 0 && !timed_out) continue;
+                bool alive;
+                if (timed_out) {
+                    alive = false;
+                } else if (!worker.ready) {
+                    uint64_t worker_fingerprint;
+                    alive = read_exact(worker.from_worker, &worker_fingerprint, sizeof(worker_fingerprint),
+                                       deadlines[i]);
+                    if (alive && have_fingerprint && worker_fingerprint != fingerprint) {
+                        std::cerr << "Workers built different scenes; scene construction must be deterministic.\n";
+                        return stop_all(false);
+                    }
+                    if (alive && !have_fingerprint) {
+                        fingerprint = worker_fingerprint;
+                        have_fingerprint = true;
+                        startup_allowance = std::max(worker_timeout_factor * seconds_since(worker.started),
+                                                     worker_timeout_minimum);
+                    }
+                    worker.ready = alive;
+                } else {
+                    alive = worker.tile >= 0 && receive_tile(worker, grid, image, message, deadlines[i]);
+                    if (alive) {
+                        tile_seconds.push_back(seconds_since(worker.started));
+                        // the median moves little once there are many tiles, so it is only recomputed now and then
+                        if (tile_seconds.size() < 64 || tile_seconds.size() % 64 == 0) {
+                            std::vector<double> sorted = tile_seconds;
+                            std::nth_element(sorted.begin(), sorted.begin() + long(sorted.size() / 2), sorted.end());
+                            median_tile_seconds = sorted[sorted.size() / 2];
+                        }
+                        worker.tile = -1;
+                        std::clog << "\rTiles remaining: " << --tiles_remaining << "   " << std::flush;
+                    }
+                }
+                if (alive) continue;
+
+                // the worker is gone or hangs (also when it stopped halfway through a message): reissue its
+                // tile and start a replacement
+                timed_out = timed_out || std::chrono::steady_clock::now() >= deadlines[i];
+                if (worker.tile >= 0) {
+                    if (++failures[worker.tile] >= 3) {
+                        std::cerr << "\nTile " << worker.tile << " failed on three workers; giving up.\n";
+                        return stop_all(false);
+                    }
+                    pending.push_front(worker.tile);
+                }
+                std::cerr << "\nWorker " << worker.pid << (timed_out ? " stopped responding; " : " was lost; ")
+                          << (worker.tile >= 0 ? "reissuing its tile" : "no tile was in progress") << ".\n";
+                close_worker(worker);
+                workers.erase(workers.begin() + long(i));
+                if (restarts_left-- <= 0 || !start_worker()) {
+                    if (workers.empty()) {
+                        std::cerr << "No workers left.\n";
+                        return stop_all(false);
+                    }
+                }
+                break;  // workers and polled no longer line up
+            }
+        }
+        std::clog << '\n';
+        return stop_all(true);
+    }
+
+    int active_workers() const { return int(workers.size()); }
+
+private:
+    struct worker_process {
+        pid_t pid = -1;
+        int to_worker = -1;
+        int from_worker = -1;
+        bool ready = false;
+        // tile being rendered, or -1
+        int tile = -1;
+        // when the current tile was handed out, or when the process was started
+        std::chrono::steady_clock::time_point started;
+    };
+
+    static double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static worker_deadline deadline_after(std::chrono::steady_clock::time_point start, double seconds) {
+        auto duration = std::chrono::duration_cast<worker_deadline::duration>(std::chrono::duration<double>(seconds));
+        return start + duration;
+    }
+
+    std::vector<std::string> command;
+    int worker_count;
+    std::vector<worker_process> workers;
+
+    bool start_worker() {
+        int to_child[2], from_child[2];
+        if (::pipe(to_child) != 0) return false;
+        if (::pipe(from_child) != 0) {
+            ::close(to_child[0]);
+            ::close(to_child[1]);
+            return false;
+        }
+        // keep the coordinator's ends (and those of other workers) out of every worker
+        for (int fd : { to_child[0], to_child[1], from_child[0], from_child[1] }) ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        std::vector<char*> arguments;
+        for (std::string& argument : command) arguments.push_back(&argument[0]);
+        arguments.push_back(nullptr);
+
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::dup2(to_child[0], STDIN_FILENO);
+            ::dup2(from_child[1], STDOUT_FILENO);
+            ::execvp(arguments[0], arguments.data());
+            ::_exit(127);
+        }
+        ::close(to_child[0]);
+        ::close(from_child[1]);
+        if (pid < 0) {
+            ::close(to_child[1]);
+            ::close(from_child[0]);
+            std::cerr << "Could not start a worker process.\n";
+            return false;
+        }
+        worker_process worker;
+        worker.pid = pid;
+        worker.started = std::chrono::steady_clock::now();
+        worker.to_worker = to_child[1];
+        worker.from_worker = from_child[0];
+        workers.push_back(worker);
+        return true;
+    }
+
+    static bool receive_tile(const worker_process& worker, const tile_grid& grid, framebuffer& image,
+                             std::vector<uint8_t>& message, worker_deadline deadline) {
+        int32_t tile_index;
+        if (!read_exact(worker.from_worker, &tile_index, sizeof(tile_index), deadline) || tile_index != worker.tile) {
+            return false;
+        }
+        int x0, y0, x1, y1;
+        grid.bounds(tile_index, x0, y0, x1, y1);
+        message.resize(size_t(x1 - x0) * (y1 - y0) * checkpoint_pixel_bytes);
+        if (!read_exact(worker.from_worker, message.data(), message.size(), deadline)) return false;
+        size_t offset = 0;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) checkpoint_get_pixel(message, offset, image.pixel(x, y));
+        }
+        return true;
+    }
+
+    static void close_worker(worker_process& worker) {
+        ::close(worker.to_worker);
+        ::close(worker.from_worker);
+        ::kill(worker.pid, SIGKILL);
+        ::waitpid(worker.pid, nullptr, 0);
+    }
+
+    // Tell every worker to exit (or kill them on failure) and wait for them.
+    bool stop_all(bool success) {
+        for (worker_process& worker : workers) {
+            if (success) {
+                int32_t stop = -1;
+                write_exact(worker.to_worker, &stop, sizeof(stop));
+                ::close(worker.to_worker);
+                ::close(worker.from_worker);
+                ::waitpid(worker.pid, nullptr, 0);
+            } else {
+                close_worker(worker);
+            }
+        }
+        workers.clear();
+        return success;
+    }
+};
+
+#endif
+
+#endif //LUMINA_DISTRIBUTED_H
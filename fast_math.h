@@ -0,0 +1,267 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_FAST_MATH_H
+#define LUMINA_FAST_MATH_H
+
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Approximate replacements for the libm calls on the shading path, used when fast-math rendering is on
+// (--fast-math). Each routine is a fixed sequence of multiplies, adds and selects with no branches or table
+// lookups. The shading path calls the scalar templates one value at a time; the __m128 (SSE2) and __m256
+// (AVX) overloads at the end run the same sequences on four or eight floats at once, for code that has a
+// batch of inputs. Error bounds are for T = double and are the largest errors against libm over dense
+// sweeps of the stated domains; with T = float and in the vector versions the float rounding of the inputs
+// and intermediates dominates (see fast_math_test.cpp for the float bounds).
+
+// Fast-math rendering switch; set once before rendering starts.
+inline bool& fast_math_mode() {
+    static bool enabled = false;
+    return enabled;
+}
+
+// x^5 with three multiplies instead of pow(). Relative error < 3 ulp.
+template <typename T>
+inline T fast_pow5(T x) {
+    T x2 = x * x;
+    return x2 * x2 * x;
+}
+
+// 1 / sqrt(x) for x > 0 within float range: hardware estimate (12 bits) refined by two Newton steps in T.
+// Relative error < 1e-13 for double, about 1 ulp for float.
+template <typename T>
+inline T fast_rsqrt(T x) {
+#if defined(__SSE2__) || defined(_M_X64)
+    T y = T(_mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(float(x)))));
+#else
+    T y = T(1) / std::sqrt(float(x));
+#endif
+    T half_x = T(0.5) * x;
+    y = y * (T(1.5) - half_x * y * y);
+    y = y * (T(1.5) - half_x * y * y);
+    return y;
+}
+
+// sqrt(x) for x >= 0 as x * rsqrt(x); 0 maps to 0. Same error as fast_rsqrt.
+template <typename T>
+inline T fast_sqrt(T x) {
+    return x > T(0) ? x * fast_rsqrt(x) : T(0);
+}
+
+// atan(x) for |x| <= 1: odd minimax polynomial (Abramowitz & Stegun 4.4.49). Absolute error < 2e-8.
+template <typename T>
+inline T fast_atan_unit(T x) {
+    T x2 = x * x;
+    return x * (T(0.9999993329) + x2 * (T(-0.3332985605) + x2 * (T(0.1994653599) + x2 * (T(-0.1390853351)
+           + x2 * (T(0.0964200441) + x2 * (T(-0.0559098861) + x2 * (T(0.0218612288) + x2 * T(-0.0040540580))))))));
+}
+
+// atan2(y, x), reduced to fast_atan_unit of min(|x|, |y|) / max(|x|, |y|) and unfolded by octant.
+// Absolute error < 4e-8 rad; atan2(0, 0) returns 0.
+template <typename T>
+inline T fast_atan2(T y, T x) {
+    const T half_pi = T(1.5707963267948966);
+    const T pi = T(3.1415926535897932);
+    T ax = std::fabs(x), ay = std::fabs(y);
+    T big = ax > ay ? ax : ay;
+    T small = ax > ay ? ay : ax;
+    T r = fast_atan_unit(big > T(0) ? small / big : T(0));
+    r = ay > ax ? half_pi - r : r;
+    r = x < T(0) ? pi - r : r;
+    return std::copysign(r, y);
+}
+
+// acos(x) for |x| <= 1 as sqrt(1 - |x|) times a polynomial (Abramowitz & Stegun 4.4.46), reflected for
+// negative x. Absolute error < 3e-8 rad.
+template <typename T>
+inline T fast_acos(T x) {
+    const T pi = T(3.1415926535897932);
+    T a = std::fabs(x);
+    T p = T(1.5707963050) + a * (T(-0.2145988016) + a * (T(0.0889789874) + a * (T(-0.0501743046)
+          + a * (T(0.0308918810) + a * (T(-0.0170881256) + a * (T(0.0066700901) + a * T(-0.0012624911)))))));
+    T r = std::sqrt(T(1) - a) * p;
+    return x < T(0) ? pi - r : r;
+}
+
+// sin(x): reduced to [-pi, pi] by subtracting the nearest multiple of 2 pi, folded into [-pi/2, pi/2] with
+// sin(pi - x) = sin(x), then a degree-11 odd polynomial. Absolute error < 1e-7 for |x| < 1e4 (the
+// reduction itself loses accuracy beyond that, as any reduction in T does).
+template <typename T>
+inline T fast_sin(T x) {
+    const T pi = T(3.1415926535897932);
+    const T two_pi = T(6.2831853071795865);
+    const T inverse_two_pi = T(0.15915494309189534);
+    x = x - two_pi * std::nearbyint(x * inverse_two_pi);
+    x = x > pi / 2 ? pi - x : x;
+    x = x < -pi / 2 ? -pi - x : x;
+    T x2 = x * x;
+    return x * (T(1) + x2 * (T(-1.0 / 6) + x2 * (T(1.0 / 120) + x2 * (T(-1.0 / 5040) + x2 * (T(1.0 / 362880)
+           + x2 * T(-1.0 / 39916800))))));
+}
+
+// Vector versions on float lanes, lane for lane the same operations as the scalar templates with T = float.
+// nearbyint is a conversion to int32 and back, which rounds to nearest like nearbyint and covers the
+// |x| < 1e4 domain of fast_sin many times over. Largest errors against libm on float inputs: pow5, rsqrt
+// and sqrt < 2-4 float ulp (relative); acos < 5e-7, atan2 < 4e-7 and sin < 3e-7 for |x| <= 2 pi
+// (absolute); sin < 1e-3 for |x| < 1e4, where reducing a float x by a float 2 pi costs |x| * FLT_EPSILON.
+#if defined(__SSE2__) || defined(_M_X64)
+inline __m128 fast_select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 fast_pow5(__m128 x) {
+    __m128 x2 = _mm_mul_ps(x, x);
+    return _mm_mul_ps(_mm_mul_ps(x2, x2), x);
+}
+
+inline __m128 fast_rsqrt(__m128 x) {
+    const __m128 three_halves = _mm_set1_ps(1.5f);
+    __m128 y = _mm_rsqrt_ps(x);
+    __m128 half_x = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+    y = _mm_mul_ps(y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half_x, y), y)));
+    y = _mm_mul_ps(y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half_x, y), y)));
+    return y;
+}
+
+inline __m128 fast_sqrt(__m128 x) {
+    // x * rsqrt(x) is NaN for x = 0, which the mask turns into 0
+    return _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()), _mm_mul_ps(x, fast_rsqrt(x)));
+}
+
+inline __m128 fast_atan_unit(__m128 x) {
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(-0.0040540580f);
+    const float coefficients[] = { 0.0218612288f, -0.0559098861f, 0.0964200441f, -0.1390853351f, 0.1994653599f,
+                                   -0.3332985605f, 0.9999993329f };
+    for (float c : coefficients) {
+        p = _mm_add_ps(_mm_set1_ps(c), _mm_mul_ps(x2, p));
+    }
+    return _mm_mul_ps(x, p);
+}
+
+inline __m128 fast_atan2(__m128 y, __m128 x) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign_mask, x), ay = _mm_andnot_ps(sign_mask, y);
+    __m128 big = _mm_max_ps(ax, ay);
+    __m128 small = _mm_min_ps(ax, ay);
+    __m128 r = fast_atan_unit(_mm_and_ps(_mm_cmpgt_ps(big, _mm_setzero_ps()), _mm_div_ps(small, big)));
+    r = fast_select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(1.5707963267948966f), r), r);
+    r = fast_select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.1415926535897932f), r), r);
+    return _mm_or_ps(_mm_andnot_ps(sign_mask, r), _mm_and_ps(sign_mask, y));
+}
+
+inline __m128 fast_acos(__m128 x) {
+    __m128 a = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    __m128 p = _mm_set1_ps(-0.0012624911f);
+    const float coefficients[] = { 0.0066700901f, -0.0170881256f, 0.0308918810f, -0.0501743046f, 0.0889789874f,
+                                   -0.2145988016f, 1.5707963050f };
+    for (float c : coefficients) {
+        p = _mm_add_ps(_mm_set1_ps(c), _mm_mul_ps(a, p));
+    }
+    __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)), p);
+    return fast_select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.1415926535897932f), r), r);
+}
+
+inline __m128 fast_sin(__m128 x) {
+    const __m128 pi = _mm_set1_ps(3.1415926535897932f);
+    const __m128 half_pi = _mm_set1_ps(3.1415926535897932f / 2);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.15915494309189534f))));
+    x = _mm_sub_ps(x, _mm_mul_ps(_mm_set1_ps(6.2831853071795865f), turns));
+    x = fast_select(_mm_cmpgt_ps(x, half_pi), _mm_sub_ps(pi, x), x);
+    x = fast_select(_mm_cmplt_ps(x, _mm_sub_ps(zero, half_pi)), _mm_sub_ps(_mm_sub_ps(zero, pi), x), x);
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(float(-1.0 / 39916800));
+    const float coefficients[] = { float(1.0 / 362880), float(-1.0 / 5040), float(1.0 / 120), float(-1.0 / 6), 1.0f };
+    for (float c : coefficients) {
+        p = _mm_add_ps(_mm_set1_ps(c), _mm_mul_ps(x2, p));
+    }
+    return _mm_mul_ps(x, p);
+}
+#endif
+
+#if defined(__AVX__)
+inline __m256 fast_select(__m256 mask, __m256 a, __m256 b) {
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+inline __m256 fast_pow5(__m256 x) {
+    __m256 x2 = _mm256_mul_ps(x, x);
+    return _mm256_mul_ps(_mm256_mul_ps(x2, x2), x);
+}
+
+inline __m256 fast_rsqrt(__m256 x) {
+    const __m256 three_halves = _mm256_set1_ps(1.5f);
+    __m256 y = _mm256_rsqrt_ps(x);
+    __m256 half_x = _mm256_mul_ps(_mm256_set1_ps(0.5f), x);
+    y = _mm256_mul_ps(y, _mm256_sub_ps(three_halves, _mm256_mul_ps(_mm256_mul_ps(half_x, y), y)));
+    y = _mm256_mul_ps(y, _mm256_sub_ps(three_halves, _mm256_mul_ps(_mm256_mul_ps(half_x, y), y)));
+    return y;
+}
+
+inline __m256 fast_sqrt(__m256 x) {
+    return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_mul_ps(x, fast_rsqrt(x)));
+}
+
+inline __m256 fast_atan_unit(__m256 x) {
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(-0.0040540580f);
+    const float coefficients[] = { 0.0218612288f, -0.0559098861f, 0.0964200441f, -0.1390853351f, 0.1994653599f,
+                                   -0.3332985605f, 0.9999993329f };
+    for (float c : coefficients) {
+        p = _mm256_add_ps(_mm256_set1_ps(c), _mm256_mul_ps(x2, p));
+    }
+    return _mm256_mul_ps(x, p);
+}
+
+inline __m256 fast_atan2(__m256 y, __m256 x) {
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 ax = _mm256_andnot_ps(sign_mask, x), ay = _mm256_andnot_ps(sign_mask, y);
+    __m256 big = _mm256_max_ps(ax, ay);
+    __m256 small = _mm256_min_ps(ax, ay);
+    __m256 r = fast_atan_unit(_mm256_and_ps(_mm256_cmp_ps(big, zero, _CMP_GT_OQ), _mm256_div_ps(small, big)));
+    r = fast_select(_mm256_cmp_ps(ay, ax, _CMP_GT_OQ), _mm256_sub_ps(_mm256_set1_ps(1.5707963267948966f), r), r);
+    r = fast_select(_mm256_cmp_ps(x, zero, _CMP_LT_OQ), _mm256_sub_ps(_mm256_set1_ps(3.1415926535897932f), r), r);
+    return _mm256_or_ps(_mm256_andnot_ps(sign_mask, r), _mm256_and_ps(sign_mask, y));
+}
+
+inline __m256 fast_acos(__m256 x) {
+    __m256 a = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x);
+    __m256 p = _mm256_set1_ps(-0.0012624911f);
+    const float coefficients[] = { 0.0066700901f, -0.0170881256f, 0.0308918810f, -0.0501743046f, 0.0889789874f,
+                                   -0.2145988016f, 1.5707963050f };
+    for (float c : coefficients) {
+        p = _mm256_add_ps(_mm256_set1_ps(c), _mm256_mul_ps(a, p));
+    }
+    __m256 r = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), a)), p);
+    return fast_select(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ),
+                       _mm256_sub_ps(_mm256_set1_ps(3.1415926535897932f), r), r);
+}
+
+inline __m256 fast_sin(__m256 x) {
+    const __m256 pi = _mm256_set1_ps(3.1415926535897932f);
+    const __m256 half_pi = _mm256_set1_ps(3.1415926535897932f / 2);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 turns = _mm256_cvtepi32_ps(_mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(0.15915494309189534f))));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(_mm256_set1_ps(6.2831853071795865f), turns));
+    x = fast_select(_mm256_cmp_ps(x, half_pi, _CMP_GT_OQ), _mm256_sub_ps(pi, x), x);
+    x = fast_select(_mm256_cmp_ps(x, _mm256_sub_ps(zero, half_pi), _CMP_LT_OQ),
+                    _mm256_sub_ps(_mm256_sub_ps(zero, pi), x), x);
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_set1_ps(float(-1.0 / 39916800));
+    const float coefficients[] = { float(1.0 / 362880), float(-1.0 / 5040), float(1.0 / 120), float(-1.0 / 6), 1.0f };
+    for (float c : coefficients) {
+        p = _mm256_add_ps(_mm256_set1_ps(c), _mm256_mul_ps(x2, p));
+    }
+    return _mm256_mul_ps(x, p);
+}
+#endif
+
+#endif //LUMINA_FAST_MATH_H
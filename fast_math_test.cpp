@@ -0,0 +1,256 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+// fast_math_test: sweeps every routine of fast_math.h (for T = double, and the float vector overloads)
+// against libm over the domain it is documented for and fails if the largest error found exceeds the
+// documented bound. Run through ctest.
+
+#include <lumina.h>
+
+#include <fast_math.h>
+#include <sphere.h>
+
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct error_sweep {
+    std::string name;
+    double bound;
+    double worst = 0;
+    double worst_input = 0;
+    int failures = 0;
+
+    void check(double input, double error) {
+        // a NaN, once seen, stays the worst error
+        if (!(error <= worst) && !std::isnan(worst)) {
+            worst = error;
+            worst_input = input;
+        }
+        // a NaN error counts as a failure as well
+        if (!(error <= bound)) failures++;
+    }
+
+    bool report() const {
+        std::cout << name << ": max error " << worst << " at " << worst_input << " (bound " << bound << ")";
+        if (failures > 0) std::cout << ", " << failures << " inputs over the bound";
+        std::cout << (failures > 0 ? " FAILED\n" : "\n");
+        return failures == 0;
+    }
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+// The vector type with W float lanes.
+template <int W>
+struct float_lanes;
+
+template <>
+struct float_lanes<4> {
+    typedef __m128 vector;
+    static const int width = 4;
+    static const char* name() { return "__m128"; }
+    static __m128 load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+};
+
+#if defined(__AVX__)
+template <>
+struct float_lanes<8> {
+    typedef __m256 vector;
+    static const int width = 8;
+    static const char* name() { return "__m256"; }
+    static __m256 load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+};
+#endif
+
+// Runs routine over x (and y), a vector of lanes at a time, and checks every lane against reference,
+// evaluated in double on the same float inputs.
+template <int W, typename Routine, typename Reference>
+bool check_lanes(const std::string& name, double bound, bool relative, const std::vector<float>& x,
+                 const std::vector<float>& y, Routine routine, Reference reference) {
+    typedef float_lanes<W> lanes;
+    error_sweep sweep { std::string(lanes::name()) + " " + name, bound };
+    float result[lanes::width];
+    for (size_t i = 0; i + lanes::width <= x.size(); i += lanes::width) {
+        lanes::store(result, routine(lanes::load(&x[i]), lanes::load(&y[i])));
+        for (int lane = 0; lane < lanes::width; lane++) {
+            double expected = reference(double(x[i + lane]), double(y[i + lane]));
+            double error = std::fabs(double(result[lane]) - expected);
+            sweep.check(x[i + lane], relative && expected != 0 ? error / std::fabs(expected) : error);
+        }
+    }
+    return sweep.report();
+}
+
+// The vector overloads on float lanes, over the same domains as the scalar sweeps. The bounds are the
+// float ones: the inputs are floats and every step rounds to float.
+template <int W>
+bool check_vector_routines(int steps) {
+    typedef typename float_lanes<W>::vector Vector;
+    const double pi_d = 3.1415926535897932;
+    // a multiple of every vector width
+    size_t count = size_t(steps / 8) * 8;
+    std::vector<float> x(count), y(count, 0.0f);
+    bool passed = true;
+
+    for (size_t i = 0; i < count; i++) x[i] = float(double(i) / (count - 1));
+    passed &= check_lanes<W>("fast_pow5 (relative, x in [0, 1])", 4 * FLT_EPSILON, true, x, y,
+                                  [](Vector v, Vector) { return fast_pow5(v); },
+                                  [](double v, double) { return std::pow(v, 5); });
+
+    for (size_t i = 0; i < count; i++) x[i] = float(std::pow(10.0, -37 + 74.0 * i / (count - 1)));
+    passed &= check_lanes<W>("fast_rsqrt (relative, x in [1e-37, 1e37])", 2 * FLT_EPSILON, true, x, y,
+                                  [](Vector v, Vector) { return fast_rsqrt(v); },
+                                  [](double v, double) { return 1 / std::sqrt(v); });
+    x[0] = 0;
+    passed &= check_lanes<W>("fast_sqrt (relative, x in {0} and [1e-37, 1e37])", 2 * FLT_EPSILON, true, x, y,
+                                  [](Vector v, Vector) { return fast_sqrt(v); },
+                                  [](double v, double) { return std::sqrt(v); });
+
+    for (size_t i = 0; i < count; i++) x[i] = float(-1 + 2.0 * i / (count - 1));
+    // the ends, approached ulp by ulp
+    for (size_t i = 0; i < 512; i++) {
+        x[i] = std::nextafter(i == 0 ? 1.0f : x[i - 1], 0.0f);
+        x[count - 1 - i] = -x[i];
+    }
+    x[0] = 1.0f;
+    x[count - 1] = -1.0f;
+    passed &= check_lanes<W>("fast_acos (absolute, x in [-1, 1])", 5e-7, false, x, y,
+                                  [](Vector v, Vector) { return fast_acos(v); },
+                                  [](double v, double) { return std::acos(v); });
+
+    for (size_t i = 0; i < count; i++) {
+        double angle = -pi_d + 2 * pi_d * i / (count - 1);
+        double length = std::pow(10.0, -20 + 40.0 * (i % 97) / 96);
+        y[i] = float(length * std::sin(angle));
+        x[i] = float(length * std::cos(angle));
+    }
+    // the axes and the origin
+    const float axes[][2] = { { 0, 1 }, { 0, -1 }, { 1, 0 }, { -1, 0 }, { 1, 1 }, { -1, 1 }, { 1, -1 }, { 0, 0 } };
+    for (int i = 0; i < 8; i++) {
+        y[i] = axes[i][0];
+        x[i] = axes[i][1];
+    }
+    passed &= check_lanes<W>("fast_atan2 (absolute, all directions and magnitudes)", 4e-7, false, x, y,
+                                  [](Vector v, Vector w) { return fast_atan2(w, v); },
+                                  [](double v, double w) { return v == 0 && w == 0 ? 0.0 : std::atan2(w, v); });
+    std::fill(y.begin(), y.end(), 0.0f);
+
+    for (size_t i = 0; i < count; i++) x[i] = float(-2 * pi_d + 4 * pi_d * i / (count - 1));
+    passed &= check_lanes<W>("fast_sin (absolute, |x| <= 2 pi)", 3e-7, false, x, y,
+                                  [](Vector v, Vector) { return fast_sin(v); },
+                                  [](double v, double) { return std::sin(v); });
+    // reducing a float x by multiples of a float 2 pi loses about |x| * FLT_EPSILON
+    for (size_t i = 0; i < count; i++) x[i] = float(-1e4 + 2e4 * i / (count - 1));
+    passed &= check_lanes<W>("fast_sin (absolute, |x| < 1e4)", 1e-3, false, x, y,
+                                  [](Vector v, Vector) { return fast_sin(v); },
+                                  [](double v, double) { return std::sin(v); });
+    return passed;
+}
+#endif
+
+int main() {
+    const int steps = 2000000;
+    const double pi_d = 3.1415926535897932;
+    bool passed = true;
+
+    error_sweep pow5 { "fast_pow5 (relative, x in [0, 1])", 3 * DBL_EPSILON };
+    for (int i = 0; i <= steps; i++) {
+        double x = double(i) / steps;
+        double reference = std::pow(x, 5);
+        pow5.check(x, reference == 0 ? std::fabs(fast_pow5(x)) : std::fabs(fast_pow5(x) - reference) / reference);
+    }
+    passed &= pow5.report();
+
+    error_sweep rsqrt { "fast_rsqrt (relative, x in [1e-37, 1e37])", 1e-13 };
+    for (int i = 0; i <= steps; i++) {
+        double x = std::pow(10.0, -37 + 74.0 * i / steps);
+        double reference = 1 / std::sqrt(x);
+        rsqrt.check(x, std::fabs(fast_rsqrt(x) - reference) / reference);
+    }
+    passed &= rsqrt.report();
+
+    error_sweep sqrt_sweep { "fast_sqrt (relative, x in {0} and [1e-37, 1e37])", 1e-13 };
+    sqrt_sweep.check(0, std::fabs(fast_sqrt(0.0)));
+    for (int i = 0; i <= steps; i++) {
+        double x = std::pow(10.0, -37 + 74.0 * i / steps);
+        double reference = std::sqrt(x);
+        sqrt_sweep.check(x, std::fabs(fast_sqrt(x) - reference) / reference);
+    }
+    passed &= sqrt_sweep.report();
+
+    error_sweep acos_sweep { "fast_acos (absolute, x in [-1, 1])", 3e-8 };
+    for (int i = 0; i <= steps; i++) {
+        double x = -1 + 2.0 * i / steps;
+        acos_sweep.check(x, std::fabs(fast_acos(x) - std::acos(x)));
+    }
+    // the ends, approached ulp by ulp
+    for (double end : { -1.0, 1.0 }) {
+        double x = end;
+        for (int i = 0; i < 1000; i++, x = std::nextafter(x, 0.0)) acos_sweep.check(x, std::fabs(fast_acos(x) - std::acos(x)));
+    }
+    passed &= acos_sweep.report();
+
+    error_sweep atan2_sweep { "fast_atan2 (absolute, all directions and magnitudes)", 4e-8 };
+    for (int i = 0; i <= steps; i++) {
+        double angle = -pi_d + 2 * pi_d * i / steps;
+        double length = std::pow(10.0, -20 + 40.0 * (i % 97) / 96);
+        double y = length * std::sin(angle), x = length * std::cos(angle);
+        atan2_sweep.check(angle, std::fabs(fast_atan2(y, x) - std::atan2(y, x)));
+    }
+    // the axes, where the octant unfolding switches
+    for (double y : { 0.0, 1.0, -1.0 }) {
+        for (double x : { 0.0, 1.0, -1.0 }) {
+            if (x == 0 && y == 0) continue;
+            atan2_sweep.check(std::atan2(y, x), std::fabs(fast_atan2(y, x) - std::atan2(y, x)));
+        }
+    }
+    atan2_sweep.check(0, std::fabs(fast_atan2(0.0, 0.0)));
+    passed &= atan2_sweep.report();
+
+    error_sweep sin_sweep { "fast_sin (absolute, |x| < 1e4)", 1e-7 };
+    for (int i = 0; i <= steps; i++) {
+        double x = -1e4 + 2e4 * i / steps;
+        sin_sweep.check(x, std::fabs(fast_sin(x) - std::sin(x)));
+    }
+    for (int i = 0; i <= steps; i++) {
+        double x = -2 * pi_d + 4 * pi_d * i / steps;
+        sin_sweep.check(x, std::fabs(fast_sin(x) - std::sin(x)));
+    }
+    passed &= sin_sweep.report();
+
+    // Sphere texture coordinates near the poles: the normal's y can be an ulp outside [-1, 1], which
+    // sphere::get_sphere_uv clamps before fast_acos. Compared with the libm path on the clamped point.
+    error_sweep uv_sweep { "sphere::get_sphere_uv (absolute, |y| near 1)", 4e-8 };
+    for (double pole : { -1.0, 1.0 }) {
+        double y = std::nextafter(std::nextafter(pole, 2 * pole), 2 * pole);
+        for (int i = 0; i < 2000; i++, y = std::nextafter(y, 0.0)) {
+            double clamped = std::fmax(-1.0, std::fmin(1.0, y));
+            double side = std::sqrt(1 - clamped * clamped);
+            point3 p(side, y, 0);
+            real u_exact, v_exact, u_fast, v_fast;
+            fast_math_mode() = false;
+            sphere::get_sphere_uv(point3(side, clamped, 0), u_exact, v_exact);
+            fast_math_mode() = true;
+            sphere::get_sphere_uv(p, u_fast, v_fast);
+            // (not fmax, which would drop a NaN)
+            double u_error = std::fabs(u_fast - u_exact), v_error = std::fabs(v_fast - v_exact);
+            uv_sweep.check(y, u_error > v_error ? u_error : v_error);
+        }
+    }
+    fast_math_mode() = false;
+    passed &= uv_sweep.report();
+
+#if defined(__SSE2__) || defined(_M_X64)
+    passed &= check_vector_routines<4>(steps);
+#endif
+#if defined(__AVX__)
+    passed &= check_vector_routines<8>(steps);
+#endif
+
+    return passed ? 0 : 1;
+}
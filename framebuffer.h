@@ -0,0 +1,150 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_FRAMEBUFFER_H
+#define LUMINA_FRAMEBUFFER_H
+
+#include <lumina.h>
+#include <color.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+inline double luminance(double r, double g, double b) {
+    return 0.2126 * r + 0.7152 * g + 0.0722 * b;
+}
+
+inline double luminance(const color3& c) {
+    return luminance(c.x, c.y, c.z);
+}
+
+// Linear HDR image with three floats per pixel, row-major with row 0 at the top.
+struct hdr_image {
+    int width;
+    int height;
+    std::vector<float> rgb;
+
+    hdr_image(int width, int height) : width(width), height(height), rgb(size_t(width) * height * 3) {}
+
+    const float* row(int y) const { return rgb.data() + size_t(y) * width * 3; }
+};
+
+// Root mean square difference over all channels of two images of the same size, taken after the display
+// transform (in [0, 1]) so that a few extremely bright samples, which the display clips, cannot dominate it.
+inline double image_rmse(const hdr_image& a, const hdr_image& b, const display_transform& display) {
+    double sum = 0;
+    for (size_t i = 0; i < a.rgb.size(); i++) {
+        double difference = double(display.encode(a.rgb[i])) - double(display.encode(b.rgb[i]));
+        sum += difference * difference;
+    }
+    return std::sqrt(sum / double(std::max<size_t>(a.rgb.size(), 1)));
+}
+
+// Running statistics for one pixel: the sum of its samples, the sum of their squared luminance and the
+// number of samples taken. That is enough to recover both the pixel mean and the variance of that mean.
+// The sums are double whatever `real` is, so that long and merged renders keep their precision.
+struct pixel_accumulator {
+    double sum[3] = { 0, 0, 0 };
+    double luminance_sq_sum = 0;
+    int sample_count = 0;
+
+    void add(const color3& sample_color) {
+        sum[0] += sample_color.x;
+        sum[1] += sample_color.y;
+        sum[2] += sample_color.z;
+        double l = luminance(sample_color);
+        luminance_sq_sum += l * l;
+        sample_count++;
+    }
+
+    // combine with the samples of another, independent render of the same pixel
+    void merge(const pixel_accumulator& other) {
+        for (int c = 0; c < 3; c++) sum[c] += other.sum[c];
+        luminance_sq_sum += other.luminance_sq_sum;
+        sample_count += other.sample_count;
+    }
+
+    color3 mean() const {
+        double scale = 1.0 / (sample_count > 0 ? sample_count : 1);
+        return color3(scale * sum[0], scale * sum[1], scale * sum[2]);
+    }
+
+    // Estimated standard error of the mean luminance, mapped into (gamma 2) display space so that the
+    // same threshold means the same visible noise in dark and bright regions.
+    double display_error() const {
+        if (sample_count < 2) return infinity;
+        double n = sample_count;
+        double mean_l = luminance(sum[0], sum[1], sum[2]) / n;
+        double variance = std::fmax(0.0, (luminance_sq_sum - n * mean_l * mean_l) / (n - 1));
+        double standard_error = std::sqrt(variance / n);
+        // d(sqrt(L)) = dL / (2 sqrt(L)); the 1/255 floor keeps near-black pixels from demanding endless samples
+        return standard_error / (2.0 * std::sqrt(std::fmax(mean_l, 0.0) + 1.0 / 255.0));
+    }
+};
+
+// Accumulation buffer shared by all render threads. Pixels are stored row-major with row 0 at the top
+// of the image (i.e. in output order). Every pixel belongs to exactly one tile, and a tile is only ever
+// rendered by one thread at a time, so no synchronisation is needed on individual pixels.
+// With LUMINA_STATS, each pixel also gets the traversal work spent on its samples.
+class framebuffer {
+public:
+    framebuffer(int width, int height)
+        : image_width(width), image_height(height), pixels(size_t(width) * height),
+          costs(stats_enabled ? size_t(width) * height : 0) {}
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+
+    pixel_accumulator& pixel(int x, int y) {
+        return pixels[size_t(y) * image_width + x];
+    }
+
+    const pixel_accumulator& pixel(int x, int y) const {
+        return pixels[size_t(y) * image_width + x];
+    }
+
+    bool has_costs() const { return !costs.empty(); }
+
+    pixel_cost& cost(int x, int y) {
+        return costs[size_t(y) * image_width + x];
+    }
+
+    const pixel_cost& cost(int x, int y) const {
+        return costs[size_t(y) * image_width + x];
+    }
+
+    long long total_samples() const {
+        long long total = 0;
+        for (const auto& p : pixels) total += p.sample_count;
+        return total;
+    }
+
+    // Adds the samples of another framebuffer of the same size, pixel by pixel.
+    void merge(const framebuffer& other) {
+        for (size_t i = 0; i < pixels.size(); i++) pixels[i].merge(other.pixels[i]);
+    }
+
+    // Mean of every pixel as linear float RGB, ready for the image writers in image_io.h.
+    hdr_image resolve() const {
+        hdr_image result(image_width, image_height);
+        float* out = result.rgb.data();
+        for (const auto& p : pixels) {
+            double scale = 1.0 / (p.sample_count > 0 ? p.sample_count : 1);
+            *out++ = float(scale * p.sum[0]);
+            *out++ = float(scale * p.sum[1]);
+            *out++ = float(scale * p.sum[2]);
+        }
+        return result;
+    }
+
+private:
+    int image_width;
+    int image_height;
+    std::vector<pixel_accumulator> pixels;
+    std::vector<pixel_cost> costs;
+};
+
+#endif //LUMINA_FRAMEBUFFER_H
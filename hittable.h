@@ -7,31 +7,63 @@
 
 #include <lumina.h>
 #include <aabb.h>
+#include <ray.h>
+
+#include <cstdint>
+#include <type_traits>
 
 class material;
+class hittable;
 
 struct hit_record   {
     point3 point;
     vec3 normal;
-    shared_ptr<material> material_ptr;
+    // non-owning; materials are owned by the scene's material_table
+    const material* material_ptr;
     // the parameter value of the root
-    double root;
+    real root;
     // texture coordinates
-    double u;
-    double v;
+    real u;
+    real v;
     // to track whether the intersection face is pointing towards the camera (visible) or not (invisible)
     bool front_face;
+    // the primitive that was hit, and which of its parts for primitives made of many (e.g. sphere_set)
+    const hittable* object;
+    uint32_t primitive_id;
+    // ray cone at the hit: its signed width there, the curvature of the surface as the ray sees it
+    // (positive where the surface bulges towards the ray) and the footprint for texture lookups
+    real cone_width;
+    real curvature;
+    texture_footprint footprint;
 
     inline void set_face_normal(const ray& r, const vec3& outward_normal)    {
         front_face = dot(r.direction, outward_normal) < 0;
-        normal = front_face ? (outward_normal / outward_normal.length()) : (-outward_normal / outward_normal.length());
+        vec3 unit_normal = unit(outward_normal);
+        normal = front_face ? unit_normal : -unit_normal;
     }
 };
 
+// Intersection is split in two phases. hit() searches for the closest intersection and only records
+// root, object and primitive_id, so candidates that a closer hit later replaces cost no more than their
+// root. finalize() then computes the point, normal, texture coordinates and material of the winner once.
+// The record holds no owning pointers, so filling and copying records during traversal never touches a
+// reference count. This fails to compile if a shared_ptr (or anything else with a non-trivial copy) is added.
+static_assert(std::is_trivially_copyable<hit_record>::value, "hit_record must stay trivially copyable");
+
 class hittable  {
 public:
     virtual bool hit(const ray& r, interval t_interval, hit_record& rec) const = 0;
     virtual aabb bounding_box() const = 0;
+    // Fill in the surface attributes of a hit on this object found by hit(). Aggregates (lists and BVHs)
+    // never end up in hit_record::object, so only primitives override this.
+    virtual void finalize(const ray& r, hit_record& rec) const {}
 };
 
+// Closest hit of r in world with all surface attributes filled in.
+inline bool closest_hit(const hittable& world, const ray& r, interval t_interval, hit_record& rec) {
+    if (!world.hit(r, t_interval, rec)) return false;
+    rec.object->finalize(r, rec);
+    return true;
+}
+
 #endif //LUMINA_HITTABLE_H
@@ -32,17 +32,14 @@ public:
 };
 
 bool hittable_list::hit(const ray& r, interval t_interval, hit_record& hit_rec) const    {
-    hit_record temp_rec;
     bool hit_anything = false;
-    auto closest_so_far = t_interval.max;
-    interval closest_so_far_interval = interval(t_interval.min, closest_so_far);
+    interval closest_so_far_interval = t_interval;
 
+    // hit() only writes the record when it reports a closer hit, so no temporary record is needed
     for (const auto& object: objects)   {
-        if (object->hit(r, closest_so_far_interval, temp_rec))    {
+        if (object->hit(r, closest_so_far_interval, hit_rec))    {
             hit_anything = true;
-            closest_so_far = temp_rec.root;
-            closest_so_far_interval.max = closest_so_far;
-            hit_rec = temp_rec;
+            closest_so_far_interval.max = hit_rec.root;
         }
     }
 
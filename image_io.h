@@ -0,0 +1,268 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_IMAGE_IO_H
+#define LUMINA_IMAGE_IO_H
+
+#include <lumina.h>
+#include <color.h>
+#include <framebuffer.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Output stage: encodes a resolved hdr_image in one pass into a memory buffer and writes that buffer with
+// a single call. 8-bit formats go through a display_transform; PFM keeps the linear floats.
+//   .ppm  binary PPM (P6), 8 bits per channel
+//   .pfm  portable float map, linear HDR, 32-bit float per channel
+//   .png  8-bit RGB PNG with uncompressed (stored) deflate blocks, so that writing costs no more than a copy
+enum class image_format { ppm, pfm, png };
+
+// Picks the format from the file extension; returns false for an unknown extension.
+inline bool image_format_from_path(const std::string& path, image_format& format) {
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos) return false;
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension) c = char(std::tolower(static_cast<unsigned char>(c)));
+    if (extension == "ppm") format = image_format::ppm;
+    else if (extension == "pfm") format = image_format::pfm;
+    else if (extension == "png") format = image_format::png;
+    else return false;
+    return true;
+}
+
+inline void append_text(std::vector<uint8_t>& out, const std::string& text) {
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+inline void append_display_row(uint8_t* out, const float* row, int width, const display_transform& display) {
+    for (int i = 0; i < width * 3; i++) out[i] = display.to_byte(row[i]);
+}
+
+inline std::vector<uint8_t> encode_ppm(const hdr_image& image, const display_transform& display) {
+    std::vector<uint8_t> out;
+    append_text(out, "P6\n" + std::to_string(image.width) + ' ' + std::to_string(image.height) + "\n255\n");
+    size_t header_size = out.size();
+    size_t row_bytes = size_t(image.width) * 3;
+    out.resize(header_size + row_bytes * image.height);
+    for (int y = 0; y < image.height; y++) {
+        append_display_row(out.data() + header_size + y * row_bytes, image.row(y), image.width, display);
+    }
+    return out;
+}
+
+inline std::vector<uint8_t> encode_pfm(const hdr_image& image) {
+    // a negative scale marks little-endian data; rows are stored bottom to top
+    const uint16_t probe = 1;
+    bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    std::vector<uint8_t> out;
+    append_text(out, "PF\n" + std::to_string(image.width) + ' ' + std::to_string(image.height)
+                     + (little_endian ? "\n-1.0\n" : "\n1.0\n"));
+    size_t header_size = out.size();
+    size_t row_bytes = size_t(image.width) * 3 * sizeof(float);
+    out.resize(header_size + row_bytes * image.height);
+    for (int y = 0; y < image.height; y++) {
+        std::memcpy(out.data() + header_size + (image.height - 1 - y) * row_bytes, image.row(y), row_bytes);
+    }
+    return out;
+}
+
+// CRC-32 (ISO 3309) as used by PNG chunks, computed four bytes at a time with four lookup tables
+// ("slicing by 4").
+inline uint32_t png_crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(4 * 256);
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        for (uint32_t n = 0; n < 256; n++) {
+            for (int slice = 1; slice < 4; slice++) {
+                uint32_t previous = t[(slice - 1) * 256 + n];
+                t[slice * 256 + n] = t[previous & 0xFF] ^ (previous >> 8);
+            }
+        }
+        return t;
+    }();
+    const uint32_t* t = table.data();
+    crc = ~crc;
+    for (; size >= 4; size -= 4, data += 4) {
+        crc ^= uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+        crc = t[3 * 256 + (crc & 0xFF)] ^ t[2 * 256 + ((crc >> 8) & 0xFF)] ^ t[256 + ((crc >> 16) & 0xFF)]
+              ^ t[crc >> 24];
+    }
+    for (; size > 0; size--, data++) crc = t[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Adler-32 checksum of the zlib stream, reducing modulo 65521 only every 5552 bytes (the most that cannot
+// overflow 32 bits).
+inline uint32_t zlib_adler32(const uint8_t* data, size_t size, uint32_t adler = 1) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0) {
+        size_t chunk = size < 5552 ? size : 5552;
+        for (size_t i = 0; i < chunk; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += chunk;
+        size -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+inline void append_u32_big_endian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(uint8_t(value >> 24));
+    out.push_back(uint8_t(value >> 16));
+    out.push_back(uint8_t(value >> 8));
+    out.push_back(uint8_t(value));
+}
+
+// Appends one PNG chunk: length, type, data and the CRC of type and data.
+inline void append_png_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    append_u32_big_endian(out, uint32_t(size));
+    size_t type_offset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    append_u32_big_endian(out, png_crc32(out.data() + type_offset, size + 4));
+}
+
+inline std::vector<uint8_t> encode_png(const hdr_image& image, const display_transform& display) {
+    // The image data is a zlib stream of stored deflate blocks of at most 65535 bytes. It holds the
+    // scanlines, each preceded by filter type 0 (none). Rows are converted into a small buffer and copied
+    // straight to their place in the output, splitting them wherever a block header falls.
+    const size_t max_block = 65535;
+    size_t row_bytes = size_t(image.width) * 3;
+    size_t raw_size = (row_bytes + 1) * image.height;
+    size_t block_count = raw_size == 0 ? 1 : (raw_size + max_block - 1) / max_block;
+    size_t zlib_size = 2 + 5 * block_count + raw_size + 4;
+
+    std::vector<uint8_t> out;
+    out.reserve(8 + 25 + 12 + zlib_size + 12);
+    const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+    std::vector<uint8_t> header;
+    append_u32_big_endian(header, uint32_t(image.width));
+    append_u32_big_endian(header, uint32_t(image.height));
+    // 8 bits per channel, colour type 2 (RGB), deflate, adaptive filtering, no interlace
+    const uint8_t header_tail[5] = { 8, 2, 0, 0, 0 };
+    header.insert(header.end(), header_tail, header_tail + 5);
+    append_png_chunk(out, "IHDR", header.data(), header.size());
+
+    append_u32_big_endian(out, uint32_t(zlib_size));
+    size_t chunk_start = out.size();
+    out.insert(out.end(), { 'I', 'D', 'A', 'T' });
+    out.push_back(0x78);  // deflate, 32K window
+    out.push_back(0x01);  // no preset dictionary, fastest compression level, header checksum
+    size_t block_left = 0;
+    size_t raw_left = raw_size;
+    uint32_t adler = 1;
+    auto append_raw = [&](const uint8_t* data, size_t size) {
+        adler = zlib_adler32(data, size, adler);
+        while (size > 0) {
+            if (block_left == 0) {
+                block_left = std::min(max_block, raw_left);
+                raw_left -= block_left;
+                out.push_back(raw_left == 0 ? 1 : 0);
+                out.push_back(uint8_t(block_left));
+                out.push_back(uint8_t(block_left >> 8));
+                out.push_back(uint8_t(~block_left));
+                out.push_back(uint8_t(~block_left >> 8));
+            }
+            size_t piece = std::min(size, block_left);
+            out.insert(out.end(), data, data + piece);
+            data += piece;
+            size -= piece;
+            block_left -= piece;
+        }
+    };
+    if (raw_size == 0) out.insert(out.end(), { 1, 0, 0, 0xFF, 0xFF });
+    std::vector<uint8_t> line(row_bytes + 1);
+    for (int y = 0; y < image.height; y++) {
+        line[0] = 0;
+        append_display_row(line.data() + 1, image.row(y), image.width, display);
+        append_raw(line.data(), line.size());
+    }
+    append_u32_big_endian(out, adler);
+    append_u32_big_endian(out, png_crc32(out.data() + chunk_start, out.size() - chunk_start));
+
+    append_png_chunk(out, "IEND", nullptr, 0);
+    return out;
+}
+
+// False-colour ramp for heatmaps: dark blue at 0 through blue, cyan and yellow to red at 1.
+inline color3 heatmap_color(double value) {
+    static const double stops[5][3] = { { 0, 0, 0.5 }, { 0, 0, 1 }, { 0, 1, 1 }, { 1, 1, 0 }, { 1, 0, 0 } };
+    double position = clamp(value, 0.0, 1.0) * 4;
+    int i = std::min(int(position), 3);
+    double f = position - i;
+    return color3((1 - f) * stops[i][0] + f * stops[i + 1][0], (1 - f) * stops[i][1] + f * stops[i + 1][1],
+                  (1 - f) * stops[i][2] + f * stops[i + 1][2]);
+}
+
+// Traversal cost heatmap of a framebuffer with costs (LUMINA_STATS): box and primitive tests per sample of
+// every pixel, relative to full_scale, which is set to the 99th percentile so that a few extreme pixels do
+// not wash out the rest. Colours are squared on the way in, as the writers apply the gamma 2 display curve.
+inline hdr_image cost_heatmap(const framebuffer& image, double& full_scale) {
+    int width = image.width(), height = image.height();
+    std::vector<double> per_sample(size_t(width) * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int samples = std::max(image.pixel(x, y).sample_count, 1);
+            per_sample[size_t(y) * width + x] = double(image.cost(x, y).traversal_cost()) / samples;
+        }
+    }
+    std::vector<double> sorted = per_sample;
+    size_t percentile = sorted.empty() ? 0 : (sorted.size() - 1) * 99 / 100;
+    if (!sorted.empty()) std::nth_element(sorted.begin(), sorted.begin() + percentile, sorted.end());
+    full_scale = sorted.empty() ? 0.0 : std::max(sorted[percentile], 1.0);
+
+    hdr_image heatmap(width, height);
+    for (size_t i = 0; i < per_sample.size(); i++) {
+        color3 c = heatmap_color(per_sample[i] / full_scale);
+        heatmap.rgb[3 * i] = float(c.x * c.x);
+        heatmap.rgb[3 * i + 1] = float(c.y * c.y);
+        heatmap.rgb[3 * i + 2] = float(c.z * c.z);
+    }
+    return heatmap;
+}
+
+// path with suffix inserted before the extension: motion_blur.ppm -> motion_blur_cost.ppm
+inline std::string path_with_suffix(const std::string& path, const std::string& suffix) {
+    size_t dot = path.rfind('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + suffix;
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// Encodes the image in the format given by the extension of path and writes it. Returns false (after
+// printing the reason) if the extension is unknown or the file cannot be written.
+inline bool write_image(const std::string& path, const hdr_image& image, const display_transform& display) {
+    image_format format;
+    if (!image_format_from_path(path, format)) {
+        std::cerr << "Unknown image format for '" << path << "' (use .ppm, .pfm or .png).\n";
+        return false;
+    }
+    std::vector<uint8_t> encoded;
+    if (format == image_format::ppm) encoded = encode_ppm(image, display);
+    else if (format == image_format::pfm) encoded = encode_pfm(image);
+    else encoded = encode_png(image, display);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(encoded.data()), std::streamsize(encoded.size()));
+    if (!file) {
+        std::cerr << "Could not write '" << path << "'.\n";
+        return false;
+    }
+    return true;
+}
+
+#endif //LUMINA_IMAGE_IO_H
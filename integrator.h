@@ -0,0 +1,98 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_INTEGRATOR_H
+#define LUMINA_INTEGRATOR_H
+
+#include <lumina.h>
+#include <hittable.h>
+#include <material.h>
+#include <stats.h>
+
+#include <string>
+
+enum class integrator_type {
+    recursive,  // ray_color(): one stack frame per bounce, fixed depth cap
+    path        // path_color(): iterative, Russian roulette termination
+};
+
+inline bool parse_integrator_type(const std::string& name, integrator_type& type) {
+    if (name == "recursive") type = integrator_type::recursive;
+    else if (name == "path") type = integrator_type::path;
+    else return false;
+    return true;
+}
+
+inline color3 background_color(const ray& r) {
+    vec3 unit_direction = unit(r.direction);
+    auto t = 0.5*(unit_direction.y+1.0);
+    return (1.0-t)*color3(1.0, 1.0, 1.0) + t*color3(0.5, 0.7, 1.0);
+}
+
+color3 ray_color(const ray& r, const hittable& world, int recursion_depth)  {
+    // Check recursion depth to prevent stack fill-up
+    if (recursion_depth <= 0)    {
+        return color3(0, 0, 0);
+    }
+    hit_record hit_rec;
+    // Use t_min = 0.001 to avoid shadow acne issues
+    interval hit_interval = interval(0.001, infinity);
+    LUMINA_COUNT(rays);
+    if (closest_hit(world, r, hit_interval, hit_rec)) {
+        ray scattered;
+        color3 attenuation;
+        // every bounce draws from its own sub-stream of the (pixel, sample) stream
+        thread_random_stream().next_bounce();
+        LUMINA_COUNT(scatter_calls[int(hit_rec.material_ptr->type())]);
+        if (hit_rec.material_ptr->scatter(r, hit_rec, attenuation, scattered))  {
+            return attenuation * ray_color(scattered, world, recursion_depth - 1);
+        }
+        return color3(0, 0, 0);
+    }
+    return background_color(r);
+}
+
+// Number of bounces that are always traced before Russian roulette may end a path.
+const int roulette_start_depth = 3;
+
+inline double roulette_continue_probability(const color3& throughput) {
+    // q follows the throughput so that dim paths are culled early; the 0.95 cap guarantees termination
+    // inside lossless dielectrics where the throughput never drops
+    return std::fmin(std::fmax(throughput.x, std::fmax(throughput.y, throughput.z)), 0.95);
+}
+
+color3 path_color(ray r, const hittable& world)  {
+    // Iterative version of ray_color(): the product of the attenuations seen so far is carried along as
+    // the path throughput instead of being multiplied in on the way back up the call stack.
+    color3 throughput(1, 1, 1);
+    hit_record hit_rec;
+    ray scattered;
+    color3 attenuation;
+    random_stream& rng = thread_random_stream();
+
+    for (int depth = 0; ; depth++) {
+        // Use t_min = 0.001 to avoid shadow acne issues
+        LUMINA_COUNT(rays);
+        if (!closest_hit(world, r, interval(0.001, infinity), hit_rec)) {
+            return throughput * background_color(r);
+        }
+        rng.next_bounce();
+        LUMINA_COUNT(scatter_calls[int(hit_rec.material_ptr->type())]);
+        if (!hit_rec.material_ptr->scatter(r, hit_rec, attenuation, scattered)) {
+            return color3(0, 0, 0);
+        }
+        throughput = throughput * attenuation;
+
+        if (depth >= roulette_start_depth) {
+            // Russian roulette: continue with probability q and divide the survivors by q, which keeps the
+            // estimator unbiased
+            double q = roulette_continue_probability(throughput);
+            if (rng.next_double() >= q) return color3(0, 0, 0);
+            throughput /= q;
+        }
+        r = scattered;
+    }
+}
+
+#endif //LUMINA_INTEGRATOR_H
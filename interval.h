@@ -9,8 +9,8 @@
 
 class interval {
 public:
-    double min;
-    double max;
+    real min;
+    real max;
 
     interval() {
         // create an open limitless interval
@@ -18,7 +18,7 @@ public:
         max = -INFINITY;
     }
 
-    interval(const double& i_min, const double& i_max) : min(i_min), max(i_max) {}
+    interval(const real& i_min, const real& i_max) : min(i_min), max(i_max) {}
 
     interval(const interval& a, const interval& b) {
         min = a.min <= b.min ? a.min : b.min;
@@ -34,26 +34,26 @@ public:
         else return interval(std::max(min, second_interval.min), std::min(max, second_interval.max));
     }
 
-    double size() const   {
+    real size() const   {
         return max - min;
     }
 
-    bool contains(double x) {
+    bool contains(real x) {
         return min <= x && x <= max;
     }
 
-    bool surrounds(double x) {
+    bool surrounds(real x) {
         return min < x && x < max;
     }
 
-    double clamp(double val) {
+    real clamp(real val) {
         if (val > max) return max;
         if (val < min) return min;
         return val;
     }
 
-    interval extend(double d) {
-        double padding = d / 2;
+    interval extend(real d) {
+        real padding = d / 2;
         return interval(min - padding, max + padding);
     }
 
@@ -63,8 +63,8 @@ public:
 const interval interval::empty = interval(INFINITY, -INFINITY);
 const interval interval::universe = interval(-INFINITY, INFINITY);
 
-inline double random_double(interval range) {
-    range.min + (range.max - range.min) * random_double();
+inline real random_double(interval range) {
+    return range.min + (range.max - range.min) * random_double();
 }
 
 
@@ -0,0 +1,328 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_LINEAR_BVH_H
+#define LUMINA_LINEAR_BVH_H
+
+#include <lumina.h>
+#include <aabb.h>
+#include <bvh.h>
+#include <hittable.h>
+#include <hittable_list.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// One node of a flattened BVH: 32 bytes, so two nodes share a 64-byte cache line. Bounds are stored as
+// floats, rounded outwards so that the float box always contains the double-precision one.
+struct linear_bvh_node {
+    float bounds_min[3];
+    float bounds_max[3];
+    // interior node: index of the second child (the first child immediately follows the node)
+    // leaf: index of the first primitive in the reordered primitive array
+    uint32_t offset;
+    // 0 for interior nodes
+    uint16_t primitive_count;
+    // split axis of an interior node, used to visit the nearer child first
+    uint8_t axis;
+    uint8_t padding;
+};
+
+static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node should stay exactly 32 bytes");
+
+// Traversal keeps the pending far children on a fixed stack of this many entries, so a flattened BVH may
+// have interior nodes down to depth linear_bvh_max_depth - 1 (0 at the root) and no deeper.
+const int linear_bvh_max_depth = 64;
+
+// Whether the builders must split a node at this depth covering span primitives at the median, whatever
+// their build method. Median splits need ceil(log2 span) more levels to reach single primitives, so they
+// take over once the tree has no more levels than that to spare; SAH on very unevenly spaced primitives
+// can otherwise produce chains of near-empty splits hundreds of levels deep.
+inline bool linear_bvh_needs_median_split(int depth, size_t span) {
+    int levels = 0;
+    while ((size_t(1) << levels) < span) levels++;
+    return depth + levels >= linear_bvh_max_depth;
+}
+
+// Median split of build items (anything with a bbox) along the longest axis of their bounds; returns the
+// start of the second half.
+template <typename Item>
+inline size_t linear_bvh_median_split(std::vector<Item>& items, size_t start, size_t end, const aabb& bounds) {
+    int axis = bounds.longest_axis();
+    size_t mid = start + (end - start) / 2;
+    std::nth_element(items.begin() + start, items.begin() + mid, items.begin() + end,
+                     [axis](const Item& a, const Item& b) {
+                         return a.bbox.axis_interval(axis).min < b.bbox.axis_interval(axis).min;
+                     });
+    return mid;
+}
+
+inline float linear_bvh_round_down(double value) {
+    float f = float(value);
+    return double(f) > value ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+inline float linear_bvh_round_up(double value) {
+    float f = float(value);
+    return double(f) < value ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+
+inline void linear_bvh_store_bounds(linear_bvh_node& node, const aabb& bounds) {
+    for (int axis = 0; axis < 3; axis++) {
+        interval range = bounds.axis_interval(axis);
+        node.bounds_min[axis] = linear_bvh_round_down(range.min);
+        node.bounds_max[axis] = linear_bvh_round_up(range.max);
+    }
+}
+
+// Slab test of a node's float box, given the ray origin and reciprocal direction as floats.
+inline bool linear_bvh_box_hit(const linear_bvh_node& node, const float* origin, const float* inverse_direction,
+                               const interval& ray_t) {
+    float t_min = float(ray_t.min);
+    float t_max = float(ray_t.max);
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (node.bounds_min[axis] - origin[axis]) * inverse_direction[axis];
+        float t1 = (node.bounds_max[axis] - origin[axis]) * inverse_direction[axis];
+        if (t0 > t1) std::swap(t0, t1);
+        // widen the far distance a little to make up for float rounding in the two lines above
+        t1 *= 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+        t_min = t0 > t_min ? t0 : t_min;
+        t_max = t1 < t_max ? t1 : t_max;
+        if (t_min > t_max) return false;
+    }
+    return true;
+}
+
+// Closest-hit traversal of a flattened BVH with at least one node. hit_primitive(i, ray_t) intersects
+// primitive i (in leaf order) with the ray and, if it finds a hit within ray_t, records it in rec and
+// returns true.
+template <typename HitPrimitive>
+inline bool linear_bvh_closest_hit(const linear_bvh_node* nodes, const ray& r, interval ray_t, hit_record& rec,
+                                   HitPrimitive&& hit_primitive) {
+    // per-ray constants for the slab tests
+    float origin[3] = { float(r.origin.x), float(r.origin.y), float(r.origin.z) };
+    float inverse_direction[3] = { float(1.0 / r.direction.x), float(1.0 / r.direction.y), float(1.0 / r.direction.z) };
+    bool direction_is_negative[3] = { inverse_direction[0] < 0, inverse_direction[1] < 0, inverse_direction[2] < 0 };
+
+    bool hit_anything = false;
+    uint32_t stack[linear_bvh_max_depth];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    while (true) {
+        LUMINA_COUNT(bvh_nodes_visited);
+        LUMINA_COUNT(aabb_tests);
+        const linear_bvh_node& node = nodes[node_index];
+        if (linear_bvh_box_hit(node, origin, inverse_direction, ray_t)) {
+            if (node.primitive_count > 0) {
+                for (uint32_t i = 0; i < node.primitive_count; i++) {
+                    if (hit_primitive(node.offset + i, ray_t)) {
+                        hit_anything = true;
+                        ray_t.max = rec.root;
+                    }
+                }
+                if (stack_size == 0) break;
+                node_index = stack[--stack_size];
+            } else if (direction_is_negative[node.axis]) {
+                // the second child lies on the near side of the split for this ray
+                stack[stack_size++] = node_index + 1;
+                node_index = node.offset;
+            } else {
+                stack[stack_size++] = node.offset;
+                node_index = node_index + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            node_index = stack[--stack_size];
+        }
+    }
+    return hit_anything;
+}
+
+// BVH compiled into one contiguous array of nodes in depth-first order, with leaves pointing into a
+// primitive array that has been reordered to match. Traversal is a loop with an explicit stack rather
+// than a chain of virtual hit() calls through heap-allocated nodes.
+class linear_bvh : public hittable {
+public:
+    linear_bvh(const hittable_list& list, const bvh_build_options& options = bvh_build_options())
+        : owned(list.objects), build_options(options) {
+        std::vector<build_item> items(owned.size());
+        for (size_t i = 0; i < owned.size(); i++) {
+            items[i].bbox = owned[i]->bounding_box();
+            items[i].index = uint32_t(i);
+        }
+        if (!items.empty()) {
+            if (options.method == bvh_build_method::lbvh) {
+                morton_codes = bvh_morton_sort(items, 0, items.size(), [](const build_item& item) { return item.bbox; },
+                                               options);
+            }
+            build_output out;
+            out.nodes.reserve(2 * items.size());
+            out.item_order.reserve(items.size());
+            build(items, 0, items.size(), options, out);
+            nodes.swap(out.nodes);
+            primitives.reserve(out.item_order.size());
+            for (uint32_t index : out.item_order) primitives.push_back(owned[index].get());
+            std::vector<uint32_t>().swap(morton_codes);
+        }
+        bbox = list.bounding_box();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (nodes.empty()) return false;
+        return linear_bvh_closest_hit(nodes.data(), r, ray_t, rec, [&](uint32_t primitive, const interval& t) {
+            return primitives[primitive]->hit(r, t, rec);
+        });
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t node_count() const { return nodes.size(); }
+    const std::vector<linear_bvh_node>& node_array() const { return nodes; }
+    const std::vector<const hittable*>& primitive_array() const { return primitives; }
+    size_t memory_bytes() const { return nodes.size() * sizeof(linear_bvh_node) + primitives.size() * sizeof(const hittable*); }
+
+    bvh_tree_stats stats() const {
+        bvh_tree_stats result;
+        if (!nodes.empty()) collect_stats(result, 0, 1, node_area(nodes[0]));
+        return result;
+    }
+
+private:
+    struct build_item {
+        aabb bbox;
+        uint32_t index;
+    };
+
+    std::vector<shared_ptr<hittable>> owned;
+    std::vector<const hittable*> primitives;
+    std::vector<linear_bvh_node> nodes;
+    bvh_build_options build_options;
+    aabb bbox;
+    // Morton codes of the (sorted) build items, only used while building with the lbvh method
+    std::vector<uint32_t> morton_codes;
+
+    // Nodes and leaf primitive order produced by one build task. Leaf offsets index into item_order.
+    struct build_output {
+        std::vector<linear_bvh_node> nodes;
+        std::vector<uint32_t> item_order;
+    };
+
+    uint32_t build(std::vector<build_item>& items, size_t start, size_t end, const bvh_build_options& options,
+                   build_output& out) {
+        aabb bounds = aabb::empty;
+        for (size_t i = start; i < end; i++) bounds = aabb(bounds, items[i].bbox);
+
+        uint32_t node_index = uint32_t(out.nodes.size());
+        out.nodes.emplace_back();
+        linear_bvh_store_bounds(out.nodes[node_index], bounds);
+
+        size_t span = end - start;
+        size_t mid = end;
+        if (span > 1) {
+            if (linear_bvh_needs_median_split(options.depth, span)) {
+                // lbvh items are already in Morton order; halving that order keeps them in step with the codes
+                mid = options.method == bvh_build_method::lbvh ? start + span / 2
+                                                               : linear_bvh_median_split(items, start, end, bounds);
+            } else if (options.method == bvh_build_method::sah) {
+                mid = bvh_sah_partition(items, start, end, bounds, [](const build_item& item) { return item.bbox; },
+                                        options);
+            } else if (options.method == bvh_build_method::lbvh) {
+                // equal codes cannot be told apart any further, so small runs of them become one leaf
+                bool all_equal = morton_codes[start] == morton_codes[end - 1];
+                mid = all_equal && span <= size_t(options.max_leaf_size) ? end : bvh_morton_split(morton_codes, start, end);
+            } else {
+                mid = linear_bvh_median_split(items, start, end, bounds);
+            }
+        }
+
+        if (mid == end) {
+            linear_bvh_node& leaf = out.nodes[node_index];
+            leaf.offset = uint32_t(out.item_order.size());
+            leaf.primitive_count = uint16_t(span);
+            leaf.axis = 0;
+            for (size_t i = start; i < end; i++) out.item_order.push_back(items[i].index);
+            return node_index;
+        }
+
+        // the first child must be the one on the negative side of the split axis, which is the axis along
+        // which the centres of the two halves lie furthest apart
+        aabb lower = aabb::empty, upper = aabb::empty;
+        for (size_t i = start; i < mid; i++) lower = aabb(lower, items[i].bbox);
+        for (size_t i = mid; i < end; i++) upper = aabb(upper, items[i].bbox);
+        vec3 gap = upper.centroid() - lower.centroid();
+        int axis = largest_component(gap);
+        size_t first_start = start, first_end = mid, second_start = mid, second_end = end;
+        if (gap[axis] < 0) {
+            first_start = mid, first_end = end, second_start = start, second_end = mid;
+        }
+
+        uint32_t second_child;
+        bvh_build_options child_options = options.child_options();
+        if (options.parallel_for(span)) {
+            // build the two halves into separate outputs on two threads, then append them behind this node
+            build_output first_out, second_out;
+            std::thread first_builder([&] { build(items, first_start, first_end, child_options, first_out); });
+            build(items, second_start, second_end, child_options, second_out);
+            first_builder.join();
+            append(out, first_out);
+            second_child = append(out, second_out);
+        } else {
+            build(items, first_start, first_end, child_options, out);
+            second_child = build(items, second_start, second_end, child_options, out);
+        }
+        linear_bvh_node& node = out.nodes[node_index];
+        node.offset = second_child;
+        node.primitive_count = 0;
+        node.axis = uint8_t(axis);
+        return node_index;
+    }
+
+    // Append a subtree built on its own, rebasing its node and primitive offsets; returns its root index.
+    static uint32_t append(build_output& out, const build_output& subtree) {
+        uint32_t node_base = uint32_t(out.nodes.size());
+        uint32_t primitive_base = uint32_t(out.item_order.size());
+        for (linear_bvh_node node : subtree.nodes) {
+            node.offset += node.primitive_count > 0 ? primitive_base : node_base;
+            out.nodes.push_back(node);
+        }
+        out.item_order.insert(out.item_order.end(), subtree.item_order.begin(), subtree.item_order.end());
+        return node_base;
+    }
+
+    static int largest_component(const vec3& v) {
+        double ax = std::fabs(v.x), ay = std::fabs(v.y), az = std::fabs(v.z);
+        if (ax >= ay && ax >= az) return 0;
+        return ay >= az ? 1 : 2;
+    }
+
+    static double node_area(const linear_bvh_node& node) {
+        double dx = node.bounds_max[0] - node.bounds_min[0];
+        double dy = node.bounds_max[1] - node.bounds_min[1];
+        double dz = node.bounds_max[2] - node.bounds_min[2];
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    void collect_stats(bvh_tree_stats& result, uint32_t node_index, int depth, double root_area) const {
+        const linear_bvh_node& node = nodes[node_index];
+        result.max_depth = std::max(result.max_depth, depth);
+        if (node.primitive_count > 0) {
+            result.leaves++;
+            result.primitives += node.primitive_count;
+            result.sah_cost += build_options.intersection_cost * node.primitive_count * node_area(node) / root_area;
+            return;
+        }
+        result.interior_nodes++;
+        result.sah_cost += build_options.traversal_cost * node_area(node) / root_area;
+        collect_stats(result, node_index + 1, depth + 1, root_area);
+        collect_stats(result, node.offset, depth + 1, root_area);
+    }
+};
+
+#endif //LUMINA_LINEAR_BVH_H
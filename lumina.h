@@ -6,16 +6,29 @@
 #define LUMINA_LUMINA_H
 
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <limits>
 #include <memory>
 #include <iostream>
 #include <fstream>
 
+#include <fast_math.h>
+
 using std::shared_ptr;
 using std::make_shared;
 using std::sqrt;
 
+// Scalar type of the geometry core: vec3, ray, interval, aabb and hit_record. Building with LUMINA_FLOAT
+// defined (the Lumina_float target) makes it float, which halves the size of every vector, box and
+// record; random numbers, camera set-up and pixel accumulation (see pixel_accumulator) stay in double
+// either way.
+#ifdef LUMINA_FLOAT
+typedef float real;
+#else
+typedef double real;
+#endif
+
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
 
@@ -24,9 +37,73 @@ inline double degrees_to_radians(double degrees)    {
     return degrees*pi/180.0;
 }
 
+// Seed of the per-pixel sample streams; set once before rendering starts. Renders of the same scene with
+// different seeds draw independent samples, so their checkpoints can be merged (see checkpoint.h). Seed 0
+// gives the streams Lumina has always used. Scene generation does not depend on it.
+inline uint64_t& render_seed() {
+    static uint64_t seed = 0;
+    return seed;
+}
+
+// Counter-based random number generator. A stream is identified by a 64-bit key derived from
+// (pixel, sample, bounce); the n-th number of the stream is a hash of (key, n). Nothing depends on
+// which thread draws the numbers or in what order pixels are visited, so a render is bit-identical
+// for any thread count, and no state is shared between threads.
+class random_stream {
+public:
+    random_stream() : key(0), counter(0) {}
+
+    void seed(uint64_t pixel, uint64_t sample, uint64_t bounce = 0) {
+        pixel_key = mix((pixel + 0x9E3779B97F4A7C15ull) ^ (render_seed() * 0xC2B2AE3D27D4EB4Full));
+        sample_key = mix(pixel_key ^ (sample * 0xD1B54A32D192ED03ull));
+        set_bounce(bounce);
+    }
+
+    // switch to the sub-stream for the given bounce of the current (pixel, sample)
+    void set_bounce(uint64_t bounce) {
+        current_bounce = bounce;
+        key = mix(sample_key ^ (bounce * 0xAF251AF3B0F025B5ull));
+        counter = 0;
+    }
+
+    void next_bounce() { set_bounce(current_bounce + 1); }
+
+    uint64_t bounce() const { return current_bounce; }
+
+    uint64_t next_u64() {
+        return mix(key + (++counter) * 0x9E3779B97F4A7C15ull);
+    }
+
+    double next_double() {
+        // top 53 bits as a fraction, i.e. a uniform double in [0, 1)
+        return (next_u64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t key;
+    uint64_t counter;
+    uint64_t pixel_key = 0;
+    uint64_t sample_key = 0;
+    uint64_t current_bounce = 0;
+
+    static uint64_t mix(uint64_t z) {
+        // SplitMix64 finaliser
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+inline random_stream& thread_random_stream() {
+    // each thread draws from its own stream; threads that never seed it (e.g. the one building the
+    // scene) start from the same fixed key, so scene generation stays deterministic as well
+    thread_local random_stream stream;
+    return stream;
+}
+
 inline double random_double()   {
-    // return a random real number in the range [0, 1]
-    return rand()/(RAND_MAX+1.0);
+    // return a random real number in the range [0, 1)
+    return thread_random_stream().next_double();
 }
 
 inline double random_double(double min, double max) {
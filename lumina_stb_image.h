@@ -10,67 +10,92 @@
 
 #include <external/stb_image.h>
 
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 
+// An image decoded to three bytes per pixel. Channels hold the linear values stbi_loadf produces (8-bit
+// files are converted with its gamma of 2.2), scaled to [0, 255]. Only the bytes are kept; textures read
+// images through texture_cache, which stores them tiled.
 class lumina_image {
 public:
     lumina_image() {}
 
     lumina_image(const char* image_filename) {
+        std::string path = find(image_filename);
+        if (!path.empty() && load(path)) return;
+        std::cerr << "ERROR: Could not load image file '" << image_filename << "'.\n";
+    }
+
+    // Path of the first existing file among the likely locations of an image, or an empty string.
+    static std::string find(const char* image_filename) {
         auto filename = std::string(image_filename);
         auto imagedir = getenv("LUMINA_IMAGES");
 
         // look for the image file in some likely locations
-        if (imagedir && load(std::string(imagedir) + "/" + image_filename)) return;
-        if (load(filename)) return;
-        if (load("images/" + filename)) return;
-        if (load("../images/" + filename)) return;
-        if (load("../../images/" + filename)) return;
-        if (load("../../../images/" + filename)) return;
-        if (load("../../../../images/" + filename)) return;
-        if (load("../../../../../images/" + filename)) return;
-        if (load("../../../../../../images/" + filename)) return;
-
-        std::cerr << "ERROR: Could not load image file '" << image_filename << "'.\n";
-    }
-
-    ~lumina_image() {
-        delete[] bdata;
-        STBI_FREE(fdata);
+        if (imagedir && exists(std::string(imagedir) + "/" + image_filename)) return std::string(imagedir) + "/" + image_filename;
+        if (exists(filename)) return filename;
+        // images/, ../images/, ... ../../../../../../images/
+        std::string prefix;
+        for (int depth = 0; depth < 7; depth++) {
+            if (exists(prefix + "images/" + filename)) return prefix + "images/" + filename;
+            prefix += "../";
+        }
+        return std::string();
     }
 
     bool load(const std::string& filename) {
-        auto n = bytes_per_pixel;
-        fdata = stbi_loadf(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel);
-        if (fdata == nullptr) return false;
-
+        int n = bytes_per_pixel;
+        if (stbi_is_hdr(filename.c_str())) {
+            float* fdata = stbi_loadf(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel);
+            if (fdata == nullptr) return false;
+            bdata.resize(size_t(image_width) * image_height * bytes_per_pixel);
+            for (size_t i = 0; i < bdata.size(); i++) bdata[i] = float_to_byte(fdata[i]);
+            STBI_FREE(fdata);
+        } else {
+            // the same values as stbi_loadf followed by float_to_byte, without a float copy of the image
+            unsigned char* data = stbi_load(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel);
+            if (data == nullptr) return false;
+            unsigned char linear[256];
+            for (int i = 0; i < 256; i++) linear[i] = float_to_byte(float(std::pow(double(i / 255.0f), double(2.2f))));
+            bdata.resize(size_t(image_width) * image_height * bytes_per_pixel);
+            for (size_t i = 0; i < bdata.size(); i++) bdata[i] = linear[data[i]];
+            STBI_FREE(data);
+        }
         bytes_per_scanline = image_width * bytes_per_pixel;
-        convert_to_bytes();
         return true;
     }
 
-    int width() const { return (fdata == nullptr) ? 0 : image_width; }
-    int height() const { return (fdata == nullptr) ? 0 : image_height; }
+    int width() const { return bdata.empty() ? 0 : image_width; }
+    int height() const { return bdata.empty() ? 0 : image_height; }
 
     const unsigned char* pixel_data(int x, int y) const {
         static unsigned char magenta[] = { 255, 0, 255 };
-        if (bdata == nullptr) return magenta;
+        if (bdata.empty()) return magenta;
 
         x = clamp(x, 0, image_width);
         y = clamp(y, 0, image_height);
 
-        return bdata + y*bytes_per_scanline + x*bytes_per_pixel;
+        return bdata.data() + y*bytes_per_scanline + x*bytes_per_pixel;
     }
 
 private:
-    const int bytes_per_pixel = 3;
-    float *fdata = nullptr;
-    unsigned char *bdata = nullptr;
+    static const int bytes_per_pixel = 3;
+    std::vector<unsigned char> bdata;
     int image_width = 0;
     int image_height = 0;
     int bytes_per_scanline = 0;
 
+    static bool exists(const std::string& filename) {
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file) return false;
+        std::fclose(file);
+        return true;
+    }
+
     static int clamp(int x, int low, int high) {
         if (x < low) return low;
         if (x < high) return x;
@@ -85,17 +110,6 @@ private:
         }
         return static_cast<unsigned char>(256.0 * value);
     }
-
-    void convert_to_bytes() {
-        int total_bytes = image_width * image_height * bytes_per_pixel;
-        bdata = new unsigned char[total_bytes];
-
-        auto *bptr = bdata;
-        auto *fptr = fdata;
-        for (auto i = 0; i < total_bytes; i++, fptr++, bptr++) {
-            *bptr = float_to_byte(*fptr);
-        }
-    }
 };
 
 #endif //LUMINA_LUMINA_STB_IMAGE_H
@@ -5,18 +5,44 @@
 #include <lumina.h>
 
 #include <bvh.h>
+#include <linear_bvh.h>
+#include <wide_bvh.h>
 #include <camera.h>
 #include <color.h>
 #include <hittable_list.h>
 #include <sphere.h>
+#include <sphere_set.h>
 #include <moving_sphere.h>
 #include <material.h>
 #include <texture.h>
-
-hittable_list cover_scene_book_one() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color3(0.5, 0.5, 0.5));
+#include <framebuffer.h>
+#include <checkpoint.h>
+#include <distributed.h>
+#include <image_io.h>
+#include <integrator.h>
+#include <renderer.h>
+#include <scene.h>
+#include <scene_cache.h>
+#include <scene_file.h>
+#include <texture_cache.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+scene cover_scene_book_one() {
+    scene result;
+    hittable_list& world = result.objects;
+    material_table& materials = result.materials;
+
+    auto ground_material = materials.make<lambertian>(color3(0.5, 0.5, 0.5));
     world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
 
     for (int a = -11; a < 11; a++) {
@@ -25,49 +51,52 @@ hittable_list cover_scene_book_one() {
             point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
 
             if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+                const material* sphere_material;
 
                 if (choose_mat < 0.8) {
                     // diffuse
                     auto albedo = color3::random() * color3::random();
-                    sphere_material = make_shared<lambertian>(albedo);
+                    sphere_material = materials.make<lambertian>(albedo);
                     world.add(make_shared<sphere>(center, 0.2, sphere_material));
                 } else if (choose_mat < 0.95) {
                     // metal
                     auto albedo = color3::random(0.5, 1);
                     auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    sphere_material = materials.make<metal>(albedo, fuzz);
                     world.add(make_shared<sphere>(center, 0.2, sphere_material));
                 } else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
+                    sphere_material = materials.make<dielectric>(1.5);
                     world.add(make_shared<sphere>(center, 0.2, sphere_material));
                 }
             }
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
+    auto material1 = materials.make<dielectric>(1.5);
     world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
 
-    auto material2 = make_shared<lambertian>(color3(0.4, 0.2, 0.1));
+    auto material2 = materials.make<lambertian>(color3(0.4, 0.2, 0.1));
     world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
 
-    auto material3 = make_shared<metal>(color3(0.7, 0.6, 0.5), 0.0);
+    auto material3 = materials.make<metal>(color3(0.7, 0.6, 0.5), 0.0);
     world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
 
-    return world;
+    return result;
 }
 
-hittable_list bouncing_balls_with_texture()    {
-    hittable_list world;
+scene bouncing_balls_with_texture()    {
+    scene result;
+    hittable_list& world = result.objects;
+    texture_table& textures = result.textures;
+    material_table& materials = result.materials;
 
-    auto ground_material = make_shared<lambertian>(color3(0.5, 0.5, 0.5));
+    auto ground_material = materials.make<lambertian>(color3(0.5, 0.5, 0.5));
     world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
 
     // checkboard texture
-    auto checker = make_shared<checker_texture>(0.32, color3(0.2, 0.3, 0.1), color3(0.9, 0.9, 0.9));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(checker)));
+    auto checker = textures.make<checker_texture>(0.32, color3(0.2, 0.3, 0.1), color3(0.9, 0.9, 0.9));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.make<lambertian>(checker)));
 
     for (int a = -11; a < 11; a++) {
         for (int b = -11; b < 11; b++) {
@@ -75,104 +104,725 @@ hittable_list bouncing_balls_with_texture()    {
             point3 centre(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
 
             if ((centre - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+                const material* sphere_material;
 
                 if (choose_mat < 0.8) {
                     // diffuse
                     auto albedo = color3::random() * color3::random();
-                    sphere_material = make_shared<lambertian>(albedo);
+                    sphere_material = materials.make<lambertian>(albedo);
                     auto centre_2 = centre + vec3(0, random_double(0, 0.5), 0);
                     world.add(make_shared<moving_sphere>(centre, centre_2, 0.0, 1.0, 0.2, sphere_material));
                 } else if (choose_mat < 0.95) {
                     // metal
                     auto albedo = color3::random(0.5, 1);
                     auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
+                    sphere_material = materials.make<metal>(albedo, fuzz);
                     world.add(make_shared<sphere>(centre, 0.2, sphere_material));
                 } else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
+                    sphere_material = materials.make<dielectric>(1.5);
                     world.add(make_shared<sphere>(centre, 0.2, sphere_material));
                 }
             }
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
+    auto material1 = materials.make<dielectric>(1.5);
     world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
 
-    auto material2 = make_shared<lambertian>(color3(0.4, 0.2, 0.1));
+    auto material2 = materials.make<lambertian>(color3(0.4, 0.2, 0.1));
     world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
 
-    auto material3 = make_shared<metal>(color3(0.7, 0.6, 0.5), 0.0);
+    auto material3 = materials.make<metal>(color3(0.7, 0.6, 0.5), 0.0);
     world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
 
-    world = hittable_list(make_shared<bvh_node>(world));
-
-    return world;
+    return result;
 }
 
-hittable_list checkered_spheres() {
-    hittable_list world;
+scene checkered_spheres() {
+    scene result;
+    hittable_list& world = result.objects;
+    texture_table& textures = result.textures;
+    material_table& materials = result.materials;
 
-    auto checker = make_shared<checker_texture>(0.32, color3(0.2, 0.3, 0.1), color3(0.9, 0.9, 0.9));
+    auto checker = textures.make<checker_texture>(0.32, color3(0.2, 0.3, 0.1), color3(0.9, 0.9, 0.9));
 
-    world.add(make_shared<sphere>(point3(0, -10, 0), 10, make_shared<lambertian>(checker)));
-    world.add(make_shared<sphere>(point3(0, 10, 0), 10, make_shared<lambertian>(checker)));
+    world.add(make_shared<sphere>(point3(0, -10, 0), 10, materials.make<lambertian>(checker)));
+    world.add(make_shared<sphere>(point3(0, 10, 0), 10, materials.make<lambertian>(checker)));
 
-    return world;
+    return result;
 }
 
-hittable_list textured_globe() {
-    auto earth_texture = make_shared<image_texture>("earth.jpg");
-    auto earth_surface = make_shared<lambertian>(earth_texture);
+scene textured_globe() {
+    scene result;
+    auto earth_texture = result.textures.make<image_texture>("earthmap.jpg");
+    auto earth_surface = result.materials.make<lambertian>(earth_texture);
     auto globe = make_shared<sphere>(point3(0, 0, 0), 2, earth_surface);
-    return hittable_list(globe);
+    result.objects.add(globe);
+    result.view.lookfrom = point3(0, 0, 12);
+    return result;
+}
+
+scene perlin_spheres() {
+    scene result;
+    hittable_list& world = result.objects;
+    texture_table& textures = result.textures;
+    material_table& materials = result.materials;
+
+    auto pertext = textures.make<noise_texture>(4);
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.make<lambertian>(pertext)));
+    world.add(make_shared<sphere>(point3(0, 2, 0), 2, materials.make<lambertian>(pertext)));
+
+    return result;
 }
 
-hittable_list perlin_spheres() {
-    hittable_list world;
+// A cloud of small particles above a checkered ground, stored in one sphere_set.
+template <typename Real>
+scene particle_cloud(size_t particle_count) {
+    scene result;
+    hittable_list& world = result.objects;
+    texture_table& textures = result.textures;
+    material_table& materials = result.materials;
+
+    auto checker = textures.make<checker_texture>(0.32, color3(.2, .3, .1), color3(.9, .9, .9));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, materials.make<lambertian>(checker)));
+
+    std::vector<const material*> palette;
+    for (int i = 0; i < 12; i++) palette.push_back(materials.make<lambertian>(color3::random() * color3::random()));
+    for (int i = 0; i < 4; i++) palette.push_back(materials.make<metal>(color3::random(0.5, 1), random_double(0, 0.3)));
+
+    auto particles = make_shared<sphere_set<Real>>();
+    particles->reserve(particle_count);
+    for (size_t i = 0; i < particle_count; i++) {
+        point3 centre(random_double(-12, 12), random_double(0.1, 3.0), random_double(-12, 12));
+        particles->add(centre, random_double(0.01, 0.04), palette[random_int(0, int(palette.size()) - 1)]);
+    }
+    bvh_build_options options;
+    options.set_build_threads(thread_pool::default_thread_count());
+    particles->build(options);
+    std::clog << "Particles: " << particles->size() << " spheres in " << particles->memory_bytes() / (1024 * 1024)
+              << " MiB, " << particles->bytes_per_sphere() << " bytes per sphere (a sphere object costs at least "
+              << sphere_set<Real>::sphere_object_bytes() << ")\n";
+    world.add(particles);
+
+    return result;
+}
 
-    auto pertext = make_shared<noise_texture>(4);
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
-    world.add(make_shared<sphere>(point3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+struct program_options {
+    render_settings render;
+    std::string scene = "perlin_spheres";
+    // scene description file (see scene_file.h), used instead of scene when given
+    std::string scene_file;
+    // directory of binary scene caches (see scene_cache.h) to load scene_file through, if not empty
+    std::string scene_cache;
+    // image width / height; scene files can set it with their camera
+    double aspect_ratio = 16.0 / 9.0;
+    // build a BVH over the scene objects before rendering
+    bool use_bvh = true;
+    bvh_build_options bvh;
+    // 'tree' keeps the bvh_node hierarchy, 'linear' compiles it into a flat node array and 'bvh4'/'bvh8'
+    // collapse that into 4- or 8-wide nodes
+    std::string accel = "linear";
+    // particle_cloud scene: number of particles and whether they are stored as floats or doubles
+    size_t particle_count = 1000000;
+    bool float_particles = true;
+    // approximate transcendental functions while shading (see fast_math.h)
+    bool fast_math = false;
+    // choose texture detail from the ray footprint (see ray.h) rather than point sampling
+    bool texture_lod = true;
+    // memory for resident image texture tiles (see texture_cache.h)
+    double texture_memory_mb = double(texture_cache::default_budget >> 20);
+    // output image; the format follows from the extension (see image_io.h)
+    std::string output_path = "motion_blur.ppm";
+    display_transform display;
+    // seed of the sample streams; renders with different seeds can be merged with lumina_merge
+    uint64_t seed = 0;
+    bool seed_given = false;
+    // checkpointing: the render runs in passes of checkpoint_pass samples per pixel, and the accumulation
+    // buffer is saved to checkpoint_path after a pass once checkpoint_interval seconds have passed since the
+    // last save, and at the end
+    std::string checkpoint_path;
+    double checkpoint_interval = 600;
+    int checkpoint_pass = 16;
+    // checkpoint to continue rendering from
+    std::string resume_path;
+    // render on this many worker processes (see distributed.h)
+    int worker_count = 0;
+    // run as one of those workers, taking tiles on stdin and returning them on stdout
+    bool worker = false;
+    // print renderer_version and exit
+    bool print_version = false;
+    // error-versus-time measurement: a checkpoint of a long render of the same scene with another seed to
+    // compare against after every sample per pixel, and the times since start-up (in seconds, ascending) at
+    // which to report the error; the render stops at the last of them
+    std::string reference_path;
+    std::vector<double> time_budgets;
+};
+
+// Everything besides the seed and image size that determines the rendered image. A checkpoint stores it,
+// and is only resumed or merged with renders whose description matches.
+std::string checkpoint_config(const program_options& options) {
+    const render_settings& settings = options.render;
+    std::ostringstream config;
+    config << "renderer=" << renderer_version << " ";
+    if (!options.scene_file.empty()) config << "scene=file:" << options.scene_file;
+    else config << "scene=" << options.scene;
+    if (options.scene_file.empty() && options.scene == "particle_cloud") {
+        config << " particles=" << options.particle_count
+               << " particle-precision=" << (options.float_particles ? "float" : "double");
+    }
+    if (settings.wavefront || settings.integrator == integrator_type::path) config << " integrator=path";
+    else config << " integrator=recursive max-depth=" << settings.max_depth;
+    config << " fast-math=" << (options.fast_math ? "on" : "off");
+    config << " texture-lod=" << (options.texture_lod ? "on" : "off");
+    config << " real=" << (sizeof(real) == sizeof(float) ? "float" : "double");
+    return config.str();
+}
 
-    return world;
+bool build_scene(const program_options& options, scene& result) {
+    const std::string& name = options.scene;
+    if (!options.scene_cache.empty()) return load_cached_scene_file(options.scene_file, options.scene_cache, options.bvh, result);
+    if (!options.scene_file.empty()) return load_scene_file(options.scene_file, result);
+    if (name == "particle_cloud") {
+        result = options.float_particles ? particle_cloud<float>(options.particle_count)
+                                         : particle_cloud<double>(options.particle_count);
+    }
+    else if (name == "cover_scene_book_one") result = cover_scene_book_one();
+    else if (name == "bouncing_balls_with_texture") result = bouncing_balls_with_texture();
+    else if (name == "checkered_spheres") result = checkered_spheres();
+    else if (name == "textured_globe") result = textured_globe();
+    else result = perlin_spheres();
+    return true;
 }
 
-color3 ray_color(const ray& r, const hittable& world, int recursion_depth)  {
-    // Check recursion depth to prevent stack fill-up
-    if (recursion_depth <= 0)    {
-        return color3(0, 0, 0);
+// Options from the render statement of the scene file named on the command line, as command-line
+// arguments to parse before the real ones (which thus take precedence), and the image aspect ratio.
+bool scene_file_arguments(int argc, char* argv[], std::vector<std::string>& arguments, double& aspect_ratio) {
+    std::string path;
+    for (int arg = 1; arg + 1 < argc; arg++) {
+        if (std::string(argv[arg]) == "--scene-file") path = argv[arg + 1];
     }
-    hit_record hit_rec;
-    // Use t_min = 0.001 to avoid shadow acne issues
-    interval hit_interval = interval(0.001, infinity);
-    if (world.hit(r, hit_interval, hit_rec)) {
-        ray scattered;
-        color3 attenuation;
-        if (hit_rec.material_ptr->scatter(r, hit_rec, attenuation, scattered))  {
-            return attenuation * ray_color(scattered, world, recursion_depth - 1);
+    if (path.empty()) return true;
+    scene_file_header header;
+    if (!read_scene_file_header(path, header)) return false;
+    for (const auto& option : header.render_options) {
+        arguments.push_back("--" + option.first);
+        arguments.push_back(option.second);
+    }
+    aspect_ratio = header.view.aspect_ratio;
+    return true;
+}
+
+bool is_known_scene(const std::string& name) {
+    return name == "cover_scene_book_one" || name == "bouncing_balls_with_texture" || name == "checkered_spheres"
+           || name == "textured_globe" || name == "perlin_spheres" || name == "particle_cloud";
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --scene NAME     cover_scene_book_one, bouncing_balls_with_texture, checkered_spheres,\n"
+              << "                   textured_globe, particle_cloud or perlin_spheres (default)\n"
+              << "  --scene-file PATH\n"
+              << "                   load the scene from a text file (see scene_file.h) instead; its render\n"
+              << "                   statement supplies defaults for the options given here\n"
+              << "  --scene-cache DIR\n"
+              << "                   keep a binary copy of the scene file with its BVH in DIR (see\n"
+              << "                   scene_cache.h) and load that instead of parsing and building when it is\n"
+              << "                   up to date; needs --accel linear\n"
+              << "  --particles N    number of particles in the particle_cloud scene (default: 1000000)\n"
+              << "  --particle-precision P\n"
+              << "                   'float' (default) or 'double' storage for particle_cloud\n"
+              << "  --bvh METHOD     BVH builder: 'sah' (default), 'median', 'lbvh' (Morton order, fastest build,\n"
+              << "                   linear layouts only) or 'none'\n"
+              << "  --accel LAYOUT   BVH layout: 'linear' (default, flat node array), 'bvh4' or 'bvh8' (wide nodes\n"
+              << "                   with SIMD box tests) or 'tree' (bvh_node objects)\n"
+              << "  --threads N      number of render threads (default: one per hardware thread)\n"
+              << "  --tile-size N    edge length of render tiles in pixels (default: 16)\n"
+              << "  --width N        image width in pixels (default: 900)\n"
+              << "  --spp N          samples per pixel, the upper bound in adaptive mode (default: 50)\n"
+              << "  --adaptive       stop sampling pixels once their noise estimate is below the threshold\n"
+              << "  --min-spp N      minimum samples per pixel in adaptive mode (default: 16)\n"
+              << "  --integrator NAME\n"
+              << "                   'recursive' (fixed depth of 50) or 'path' (iterative, Russian roulette)\n"
+              << "  --wavefront      trace tiles as material-sorted waves of paths (uses the path integrator)\n"
+              << "  --wavefront-batch N\n"
+              << "                   number of paths per wave in wavefront mode (default: 16384)\n"
+              << "  --fast-math      use polynomial approximations of acos, atan2, sin, pow and 1/sqrt while shading\n"
+              << "  --texture-lod MODE\n"
+              << "                   'on' (default): filter image textures and noise to the size of the ray\n"
+              << "                   footprint, tracked through mirrors and glass; 'off': sample them at full detail\n"
+              << "  --texture-memory MB\n"
+              << "                   memory for image texture tiles; tiles beyond it are evicted and read back from\n"
+              << "                   a temporary file when needed again (default: 256)\n"
+              << "  --output PATH    output image, '.ppm' (binary, default: motion_blur.ppm), '.pfm' (linear float)\n"
+              << "                   or '.png'\n"
+              << "  --tonemap OP     'clamp' (default) or 'reinhard', applied to 8-bit outputs\n"
+              << "  --seed N         seed of the sample streams (default: 0); independent renders to merge need\n"
+              << "                   different seeds\n"
+              << "  --checkpoint PATH\n"
+              << "                   render in passes and save the accumulated samples to PATH periodically and at\n"
+              << "                   the end\n"
+              << "  --checkpoint-interval S\n"
+              << "                   minimum seconds between checkpoints (default: 600)\n"
+              << "  --checkpoint-pass N\n"
+              << "                   samples per pixel added by each pass between checkpoints (default: 16)\n"
+              << "  --resume PATH    continue from a checkpoint up to --spp samples per pixel, with the same scene\n"
+              << "                   options; checkpoints go to PATH unless --checkpoint is given\n"
+              << "  --workers N      render on N worker processes that each build the scene and take tiles from\n"
+              << "                   this process; a worker that dies or hangs has its tile handed to another\n"
+              << "  --worker         (internal) run as a worker, reading tiles on stdin and writing them to stdout\n"
+              << "  --reference PATH checkpoint of a high-spp render of the same scene and size (with another seed);\n"
+              << "                   renders one sample per pixel at a time and reports the RMSE of display values\n"
+              << "                   against it\n"
+              << "  --time-budgets T1,T2,...\n"
+              << "                   with --reference, report the error reached T1, T2, ... seconds after start-up\n"
+              << "                   and stop at the last budget (or at --spp)\n"
+              << "  --noise-threshold X\n"
+              << "                   target standard error in display space for adaptive mode (default: 0.01)\n"
+              << "  --version        print the renderer version recorded in checkpoints and exit\n";
+}
+
+bool parse_arguments(int argc, char* argv[], program_options& options) {
+    render_settings& settings = options.render;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        if (option == "--help" || option == "-h") return false;
+        if (option == "--version") {
+            options.print_version = true;
+            continue;
+        }
+        if (option == "--adaptive") {
+            settings.adaptive = true;
+            continue;
+        }
+        if (option == "--wavefront") {
+            settings.wavefront = true;
+            continue;
+        }
+        if (option == "--worker") {
+            options.worker = true;
+            continue;
+        }
+        if (option == "--fast-math") {
+            options.fast_math = true;
+            continue;
+        }
+        if (arg + 1 >= argc) {
+            std::cerr << "Missing value for option '" << option << "'.\n";
+            return false;
         }
-        return color3(0, 0, 0);
+        const char* value = argv[++arg];
+        if (option == "--threads") settings.thread_count = std::atoi(value);
+        else if (option == "--tile-size") settings.tile_size = std::atoi(value);
+        else if (option == "--width") settings.image_width = std::atoi(value);
+        else if (option == "--spp") settings.samples_per_pixel = std::atoi(value);
+        else if (option == "--min-spp") settings.min_samples_per_pixel = std::atoi(value);
+        else if (option == "--noise-threshold") settings.noise_threshold = std::atof(value);
+        else if (option == "--wavefront-batch") settings.wavefront_batch_size = std::atoi(value);
+        else if (option == "--scene-file") options.scene_file = value;
+        else if (option == "--scene-cache") options.scene_cache = value;
+        else if (option == "--scene") {
+            options.scene = value;
+            if (!is_known_scene(options.scene)) {
+                std::cerr << "Unknown scene '" << value << "'.\n";
+                return false;
+            }
+        }
+        else if (option == "--output") {
+            image_format format;
+            if (!image_format_from_path(value, format)) {
+                std::cerr << "Unknown image format for '" << value << "' (use .ppm, .pfm or .png).\n";
+                return false;
+            }
+            options.output_path = value;
+        }
+        else if (option == "--tonemap") {
+            std::string name = value;
+            if (name == "clamp") options.display.tonemap = tonemap_operator::clamp;
+            else if (name == "reinhard") options.display.tonemap = tonemap_operator::reinhard;
+            else {
+                std::cerr << "Unknown tonemap operator '" << name << "'.\n";
+                return false;
+            }
+        }
+        else if (option == "--seed") {
+            options.seed = std::strtoull(value, nullptr, 10);
+            options.seed_given = true;
+        }
+        else if (option == "--checkpoint") options.checkpoint_path = value;
+        else if (option == "--checkpoint-interval") options.checkpoint_interval = std::atof(value);
+        else if (option == "--texture-memory") options.texture_memory_mb = std::atof(value);
+        else if (option == "--texture-lod") {
+            options.texture_lod = std::string(value) == "on";
+            if (!options.texture_lod && std::string(value) != "off") {
+                std::cerr << "--texture-lod takes 'on' or 'off'.\n";
+                return false;
+            }
+        }
+        else if (option == "--checkpoint-pass") options.checkpoint_pass = std::atoi(value);
+        else if (option == "--resume") options.resume_path = value;
+        else if (option == "--workers") options.worker_count = std::atoi(value);
+        else if (option == "--reference") options.reference_path = value;
+        else if (option == "--time-budgets") {
+            std::istringstream list(value);
+            std::string budget;
+            while (std::getline(list, budget, ',')) {
+                double seconds = std::atof(budget.c_str());
+                if (seconds <= 0) {
+                    std::cerr << "Time budgets must be positive numbers of seconds.\n";
+                    return false;
+                }
+                options.time_budgets.push_back(seconds);
+            }
+            std::sort(options.time_budgets.begin(), options.time_budgets.end());
+        }
+        else if (option == "--particles") options.particle_count = size_t(std::atoll(value));
+        else if (option == "--particle-precision") {
+            options.float_particles = std::string(value) != "double";
+            if (options.float_particles && std::string(value) != "float") {
+                std::cerr << "Unknown particle precision '" << value << "'.\n";
+                return false;
+            }
+        }
+        else if (option == "--accel") {
+            options.accel = value;
+            if (options.accel != "linear" && options.accel != "tree" && options.accel != "bvh4" && options.accel != "bvh8") {
+                std::cerr << "Unknown BVH layout '" << value << "'.\n";
+                return false;
+            }
+        }
+        else if (option == "--bvh") {
+            options.use_bvh = std::string(value) != "none";
+            if (options.use_bvh && !parse_bvh_build_method(value, options.bvh.method)) {
+                std::cerr << "Unknown BVH builder '" << value << "'.\n";
+                return false;
+            }
+        }
+        else if (option == "--integrator") {
+            if (!parse_integrator_type(value, settings.integrator)) {
+                std::cerr << "Unknown integrator '" << value << "'.\n";
+                return false;
+            }
+        }
+        else {
+            std::cerr << "Unknown option '" << option << "'.\n";
+            return false;
+        }
+    }
+    if (settings.tile_size <= 0 || settings.image_width <= 1 || settings.samples_per_pixel <= 0) {
+        std::cerr << "Tile size, image width and samples per pixel must be positive.\n";
+        return false;
+    }
+    if (settings.wavefront && settings.adaptive) {
+        std::cerr << "Wavefront mode does not support adaptive sampling.\n";
+        return false;
+    }
+    if (settings.wavefront_batch_size <= 0) {
+        std::cerr << "Wavefront batch size must be positive.\n";
+        return false;
     }
-    vec3 unit_direction = unit(r.direction);
-    auto t = 0.5*(unit_direction.y+1.0);
-    return (1.0-t)*color3(1.0, 1.0, 1.0) + t*color3(0.5, 0.7, 1.0);
+    if (!(options.texture_memory_mb > 0)) {
+        std::cerr << "Texture memory must be positive.\n";
+        return false;
+    }
+    if (options.checkpoint_pass <= 0) {
+        std::cerr << "Checkpoint passes must add at least one sample per pixel.\n";
+        return false;
+    }
+    if (!options.resume_path.empty() && options.checkpoint_path.empty()) options.checkpoint_path = options.resume_path;
+    if (options.worker_count < 0
+        || (options.worker_count > 0
+            && (options.worker || !options.checkpoint_path.empty() || !options.reference_path.empty()))) {
+        std::cerr << "--workers cannot be combined with --worker, --checkpoint, --resume or --reference.\n";
+        return false;
+    }
+    if (!options.time_budgets.empty() && options.reference_path.empty()) {
+        std::cerr << "--time-budgets needs a --reference image to measure the error against.\n";
+        return false;
+    }
+    if (options.worker) {
+        // processes are the unit of parallelism; each worker renders its tiles on one thread
+        settings.thread_count = 1;
+    }
+    if (!options.scene_cache.empty() && (options.scene_file.empty() || !options.use_bvh || options.accel != "linear")) {
+        std::cerr << "--scene-cache needs a --scene-file and a linear BVH (--accel linear).\n";
+        return false;
+    }
+    if (options.accel == "tree" && options.bvh.method == bvh_build_method::lbvh) {
+        std::cerr << "The lbvh builder needs a linear BVH layout (--accel linear, bvh4 or bvh8).\n";
+        return false;
+    }
+    // the BVH is built with as many threads as will render
+    options.bvh.set_build_threads(settings.thread_count > 0 ? settings.thread_count : thread_pool::default_thread_count());
+    return true;
+}
+
+// Command line of a worker for this render: the same program and options, minus --workers, plus --worker.
+std::vector<std::string> worker_command(int argc, char* argv[]) {
+    std::vector<std::string> command = { argv[0] };
+    for (int arg = 1; arg < argc; arg++) {
+        std::string argument = argv[arg];
+        if (argument == "--workers") {
+            arg++;
+            continue;
+        }
+        command.push_back(argument);
+    }
+    command.push_back("--worker");
+    return command;
+}
+
+void print_texture_cache_stats() {
+    texture_cache_stats stats = shared_texture_cache().stats();
+    if (stats.files == 0) return;
+    double lookups = double(std::max<uint64_t>(stats.lookups, 1));
+    std::clog << "Texture cache: " << stats.files << " images in " << stats.tiles << " tiles (room for "
+              << stats.resident_limit << "), " << stats.lookups << " lookups, " << 100.0 * double(stats.misses) / lookups
+              << "% misses, " << stats.evictions << " evictions, " << double(stats.resident_bytes) / (1024 * 1024)
+              << " MiB resident\n";
+}
+
+void print_traversal_stats(const traversal_stats& totals) {
+    double rays = double(std::max<uint64_t>(totals.rays, 1));
+    std::clog << "Rays traced: " << totals.rays << ", per ray: " << double(totals.bvh_nodes_visited) / rays
+              << " BVH nodes visited, " << double(totals.aabb_tests) / rays << " box tests, "
+              << double(totals.primitive_tests) / rays << " primitive tests\n";
+    std::clog << "Scatter calls:";
+    for (int type = 0; type < int(material_type::count); type++) {
+        std::clog << " " << material_type_name(material_type(type)) << " " << totals.scatter_calls[type];
+    }
+    std::clog << "\n";
+
+    // every ray belongs to exactly one camera path
+    uint64_t paths = 0;
+    for (int length = 0; length < path_length_bins; length++) paths += totals.path_lengths[length];
+    std::clog << "Path lengths (rays per camera path): mean " << double(totals.rays) / double(std::max<uint64_t>(paths, 1));
+    // lengths up to 10 one by one, longer paths together
+    uint64_t longer = 0;
+    for (int length = 0; length < path_length_bins; length++) {
+        if (length > 10) longer += totals.path_lengths[length];
+        if (length > 10 || totals.path_lengths[length] == 0) continue;
+        std::clog << ", " << length << ": " << 100.0 * double(totals.path_lengths[length]) / double(paths) << "%";
+    }
+    if (longer > 0) std::clog << ", 11+: " << 100.0 * double(longer) / double(paths) << "%";
+    std::clog << "\n";
+}
+
+// The part of a checkpoint description that identifies the scene and the renderer version. A reference
+// image only has to match that, so renders with other integrators or precisions can be measured against
+// the same reference, but not against one drawn before a change to what the scene looks like.
+std::string scene_description(const std::string& config) {
+    return config.substr(0, config.find(" integrator="));
+}
+
+bool load_reference(const program_options& options, const checkpoint_info& render, hdr_image& reference) {
+    framebuffer image(0, 0);
+    checkpoint_info info;
+    if (!load_checkpoint(options.reference_path, image, info)) return false;
+    if (info.width != render.width || info.height != render.height
+        || scene_description(info.config) != scene_description(render.config)) {
+        std::cerr << "The reference shows another scene or size, or is from another renderer version:\n  reference: " << info.width << "x" << info.height
+                  << " " << info.config << "\n  render:    " << render.width << "x" << render.height << " "
+                  << render.config << "\n";
+        return false;
+    }
+    // a reference drawn from the same sample streams would make the error look smaller than it is
+    if (!info.merged && info.seed == render.seed) {
+        std::cerr << "The reference was rendered with the same seed (" << info.seed << "); use another --seed.\n";
+        return false;
+    }
+    reference = image.resolve();
+    std::clog << "Reference: " << options.reference_path << ", "
+              << double(image.total_samples()) / (double(image.width()) * image.height()) << " samples per pixel\n";
+    return true;
 }
 
-int main() {
+// Error of the image against the reference after one pass, with the time since start-up at which the pass
+// finished (not counting earlier measurements).
+struct error_sample {
+    double time;
+    double samples_per_pixel;
+    double rmse;
+};
+
+void print_error_curve(const std::vector<error_sample>& curve, const std::vector<double>& budgets) {
+    if (curve.empty()) return;
+    // at each budget, the error of the last image finished by then
+    for (double budget : budgets) {
+        const error_sample* reached = nullptr;
+        for (const error_sample& sample : curve) {
+            if (sample.time <= budget) reached = &sample;
+        }
+        std::clog << "Error at " << budget << " s: ";
+        if (reached) {
+            std::clog << "RMSE " << reached->rmse << ", " << reached->samples_per_pixel << " samples per pixel after "
+                      << reached->time << " s\n";
+        } else {
+            std::clog << "no pass finished\n";
+        }
+    }
+    const error_sample& last = curve.back();
+    std::clog << "Error: RMSE " << last.rmse << ", " << last.samples_per_pixel << " samples per pixel after "
+              << last.time << " s\n";
+}
+
+// Peak resident set size of this process in MB, or -1 where the platform does not report it.
+double peak_memory_mb() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return double(usage.ru_maxrss) / (1024.0 * 1024.0);
+#else
+    return double(usage.ru_maxrss) / 1024.0;
+#endif
+#else
+    return -1;
+#endif
+}
+
+bool write_output(const framebuffer& image, const program_options& options,
+                  std::chrono::steady_clock::time_point program_start) {
+    const render_settings& settings = options.render;
+    long long total_samples = image.total_samples();
+    std::clog << "Samples taken: " << total_samples << " ("
+              << double(total_samples) / (double(settings.image_width) * settings.image_height) << " per pixel)\n";
+    if (stats_enabled) print_traversal_stats(global_stats::snapshot());
+
+    std::clog << "Writing " << options.output_path << "...\n";
+    auto output_start = std::chrono::steady_clock::now();
+    if (!write_image(options.output_path, image.resolve(), options.display)) return false;
+    std::chrono::duration<double> output_time = std::chrono::steady_clock::now() - output_start;
+    std::clog << "Output time: " << output_time.count() * 1000 << " ms\n";
+
+    // in multi-process renders the counters stay with the workers
+    if (image.has_costs() && global_stats::snapshot().rays > 0) {
+        std::string heatmap_path = path_with_suffix(options.output_path, "_cost");
+        double full_scale;
+        if (!write_image(heatmap_path, cost_heatmap(image, full_scale), display_transform())) return false;
+        std::clog << "Traversal cost heatmap: " << heatmap_path << " (red: " << full_scale
+                  << " box and primitive tests per sample or more)\n";
+    }
+    std::chrono::duration<double> total_time = std::chrono::steady_clock::now() - program_start;
+    std::clog << "Total time: " << total_time.count() << " s, peak memory: " << peak_memory_mb() << " MB\n";
+    std::clog << "Done.\n";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    auto program_start = std::chrono::steady_clock::now();
+    program_options options;
+    options.bvh.method = bvh_build_method::sah;
+    std::vector<std::string> file_arguments;
+    if (!scene_file_arguments(argc, argv, file_arguments, options.aspect_ratio)) return 1;
+    if (!file_arguments.empty()) {
+        std::vector<char*> file_argv = { argv[0] };
+        for (std::string& argument : file_arguments) file_argv.push_back(&argument[0]);
+        if (!parse_arguments(int(file_argv.size()), file_argv.data(), options)) return 1;
+    }
+    if (!parse_arguments(argc, argv, options)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (options.print_version) {
+        std::cout << "Lumina renderer version " << renderer_version << "\n";
+        return 0;
+    }
+    // workers report only errors; their stdout carries results
+    if (options.worker) std::clog.rdbuf(nullptr);
     std::clog << "Setting up image attributes...\n";
+    render_settings& settings = options.render;
+    fast_math_mode() = options.fast_math;
+    texture_lod_mode() = options.texture_lod;
     // Image dimensions
-    const auto aspect_ratio = 16.0/9.0;
-    const int image_width = 900;
-    const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 50;
-    const int max_depth = 50;
+    settings.image_height = static_cast<int>(settings.image_width / options.aspect_ratio);
+
+    framebuffer image(settings.image_width, settings.image_height);
+    checkpoint_info checkpoint;
+    checkpoint.width = settings.image_width;
+    checkpoint.height = settings.image_height;
+    checkpoint.seed = options.seed;
+    checkpoint.config = checkpoint_config(options);
+    if (!options.resume_path.empty()) {
+        checkpoint_info saved;
+        if (!load_checkpoint(options.resume_path, image, saved)) return 1;
+        if (saved.merged) {
+            std::cerr << "A merged checkpoint cannot be resumed; resume its inputs and merge them again.\n";
+            return 1;
+        }
+        if (saved.width != checkpoint.width || saved.height != checkpoint.height || saved.config != checkpoint.config) {
+            std::cerr << "The checkpoint was rendered with different options:\n  checkpoint: " << saved.width << "x"
+                      << saved.height << " " << saved.config << "\n  now:        " << checkpoint.width << "x"
+                      << checkpoint.height << " " << checkpoint.config << "\n";
+            return 1;
+        }
+        if (options.seed_given && options.seed != saved.seed) {
+            std::cerr << "The checkpoint was rendered with seed " << saved.seed << ".\n";
+            return 1;
+        }
+        checkpoint.seed = saved.seed;
+        std::clog << "Resuming from " << options.resume_path << " ("
+                  << double(image.total_samples()) / (double(image.width()) * image.height()) << " samples per pixel)\n";
+    }
+    render_seed() = checkpoint.seed;
+    hdr_image reference(0, 0);
+    if (!options.reference_path.empty() && !load_reference(options, checkpoint, reference)) return 1;
+
+    if (options.worker_count > 0) {
+#ifdef LUMINA_HAS_DISTRIBUTED
+        // the workers build the scene and render; this process only hands out tiles and collects them
+        std::clog << "Rendering image on " << options.worker_count << " worker processes...\n";
+        render_coordinator coordinator(worker_command(argc, argv), options.worker_count);
+        auto render_start = std::chrono::steady_clock::now();
+        if (!coordinator.render(tile_grid(settings.image_width, settings.image_height, settings.tile_size), image)) {
+            return 1;
+        }
+        std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start;
+        std::clog << "Render time: " << render_time.count() << " s\n";
+        return write_output(image, options, program_start) ? 0 : 1;
+#else
+        std::cerr << "Multi-process rendering is not supported on this platform.\n";
+        return 1;
+#endif
+    }
 
     std::clog << "Building world scene...\n";
+    shared_texture_cache().set_budget(size_t(options.texture_memory_mb * 1024 * 1024));
     // World Definition
-    auto world = perlin_spheres();
+    auto scene_start = std::chrono::steady_clock::now();
+    scene world_scene;
+    if (!build_scene(options, world_scene)) return 1;
+    hittable_list& world = world_scene.objects;
+    std::chrono::duration<double> scene_time = std::chrono::steady_clock::now() - scene_start;
+    size_t object_count = world.objects.size();
+    std::clog << "Scene: " << object_count << " objects, built in " << scene_time.count() * 1000 << " ms\n";
+    if (options.use_bvh && !world_scene.prebuilt_bvh) {
+        auto build_start = std::chrono::steady_clock::now();
+        shared_ptr<hittable> accel;
+        bvh_tree_stats bvh_stats;
+        if (options.accel == "linear") {
+            auto bvh = make_shared<linear_bvh>(world, options.bvh);
+            bvh_stats = bvh->stats();
+            accel = bvh;
+        } else if (options.accel == "bvh4") {
+            auto bvh = make_shared<bvh4>(world, options.bvh);
+            bvh_stats = bvh->stats();
+            accel = bvh;
+        } else if (options.accel == "bvh8") {
+            auto bvh = make_shared<bvh8>(world, options.bvh);
+            bvh_stats = bvh->stats();
+            accel = bvh;
+        } else {
+            auto bvh = make_shared<bvh_node>(world, options.bvh);
+            bvh_stats = bvh->stats(options.bvh);
+            accel = bvh;
+        }
+        std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - build_start;
+        std::clog << "BVH: " << bvh_stats.interior_nodes << " nodes, " << bvh_stats.leaves << " leaves, depth "
+                  << bvh_stats.max_depth << ", SAH cost " << bvh_stats.sah_cost << ", built in "
+                  << build_time.count() * 1000 << " ms\n";
+        world = hittable_list(accel);
+    }
 
 //    auto material_ground = make_shared<lambertian>(color3(0.8, 0.8, 0.0));
 //    auto material_center = make_shared<lambertian>(color3(0.1, 0.2, 0.5));
@@ -201,49 +851,53 @@ int main() {
 //    world.add(make_shared<sphere>(point3( 1.0,    0.0, -1.0),   0.5, material_right));
 
     std::clog << "Creating camera...\n";
-    // Camera
-    // Standard 90 deg FOV
-    //camera camera(point3(-2,2,1), point3(0,0,-1), vec3(0,1,0), 90, aspect_ratio);
-    // Narrow 20 deg FOV
-    // camera for everything up till textured globe
-    point3 lookfrom = {13, 2, 3};
-    point3 lookat = {0, 0, 0};
-    vec3 upwards = {0, 1, 0};
-    double distance_to_focus = 10.0;
-    auto aperture = 0.1;
-    interval shutter_capture_interval = interval(0.0, 1.0);
-
-    // camera for textured globe
-    lookfrom = {0, 0, 12};
-    lookat = {0, 0, 0};
-
-    // camera for perlin scene
-    lookfrom = {13, 2, 3};
-    lookat = {0, 0, 0};
-
-    camera camera(lookfrom, lookat, upwards, 20, aspect_ratio, aperture, distance_to_focus, shutter_capture_interval);
-
-    std::clog << "Creating output file...\n";
-    // Draw the image
-    // Set up file to write to
-    std::ofstream image_file("motion_blur.ppm");
-    // PPM format header
-    image_file << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+    // Camera: each scene says where it is viewed from (see camera_settings)
+    world_scene.view.aspect_ratio = options.aspect_ratio;
+    camera camera = world_scene.view.make_camera();
 
     std::clog << "Rendering image...\n";
-    for (int j = image_height-1; j >= 0; --j) {
-        std::clog << "\rScanlines remaining: " << j << ' ' << std::flush;
-        for (int i = 0; i < image_width; ++i) {
-            color3 pixel_color(0, 0, 0);
-            for (int s = 0; s < samples_per_pixel; ++s) {
-                // multiple samples for anti-aliasing
-                auto u = (i + random_double()) / (image_width - 1);
-                auto v = (j + random_double()) / (image_height - 1);
-                ray r = camera.get_ray(u, v);
-                pixel_color += ray_color(r, world, max_depth);
+    renderer renderer(settings);
+#ifdef LUMINA_HAS_DISTRIBUTED
+    if (options.worker) {
+        return run_render_worker(world, camera, renderer, image, scene_fingerprint(checkpoint.config, world, object_count));
+    }
+#endif
+    std::clog << "Using " << renderer.thread_count() << " threads, " << renderer.tile_count() << " tiles of "
+              << settings.tile_size << "x" << settings.tile_size << " pixels\n";
+    auto render_start = std::chrono::steady_clock::now();
+    // time spent comparing against the reference, which is not part of the render
+    std::chrono::duration<double> measure_time(0);
+    std::vector<error_sample> error_curve;
+    if (options.checkpoint_path.empty() && options.reference_path.empty()) {
+        renderer.render(world, camera, image);
+    } else {
+        auto last_checkpoint = render_start;
+        const int pass = options.reference_path.empty() ? options.checkpoint_pass : 1;
+        for (int limit = pass; ; limit += pass) {
+            renderer.render(world, camera, image, limit);
+            bool finished = limit >= settings.samples_per_pixel;
+            if (!options.reference_path.empty()) {
+                auto measure_start = std::chrono::steady_clock::now();
+                std::chrono::duration<double> elapsed = measure_start - program_start - measure_time;
+                double samples_per_pixel = double(image.total_samples()) / (double(image.width()) * image.height());
+                error_curve.push_back({ elapsed.count(), samples_per_pixel, image_rmse(image.resolve(), reference, options.display) });
+                finished = finished || (!options.time_budgets.empty() && elapsed.count() >= options.time_budgets.back());
+                measure_time += std::chrono::steady_clock::now() - measure_start;
             }
-            write_color(image_file, pixel_color, samples_per_pixel);
+            std::chrono::duration<double> since_checkpoint = std::chrono::steady_clock::now() - last_checkpoint;
+            if (!options.checkpoint_path.empty()
+                && (finished || since_checkpoint.count() >= options.checkpoint_interval)) {
+                if (!save_checkpoint(options.checkpoint_path, image, checkpoint)) return 1;
+                last_checkpoint = std::chrono::steady_clock::now();
+                std::clog << "Checkpoint saved to " << options.checkpoint_path << " after "
+                          << std::min(limit, settings.samples_per_pixel) << " samples per pixel\n";
+            }
+            if (finished) break;
         }
     }
-    std::clog << "\nDone.\n";
-}
\ No newline at end of file
+    std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start - measure_time;
+    std::clog << "Render time: " << render_time.count() << " s\n";
+    print_texture_cache_stats();
+    print_error_curve(error_curve, options.time_budgets);
+    return write_output(image, options, program_start) ? 0 : 1;
+}
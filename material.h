@@ -7,21 +7,61 @@
 
 #include <lumina.h>
 #include <hittable.h>
+#include <stats.h>
 #include <texture.h>
 
 struct hit_record;
 
+enum class material_type { lambertian, metal, dielectric, count };
+
+static_assert(int(material_type::count) <= stats_material_types, "stats_material_types is too small");
+
+inline const char* material_type_name(material_type type) {
+    switch (type) {
+        case material_type::lambertian: return "lambertian";
+        case material_type::metal: return "metal";
+        case material_type::dielectric: return "dielectric";
+        default: return "unknown";
+    }
+}
+
+// Ray cones of scattered rays (see ray.h), which start from the width of the incoming cone at the hit.
+// A mirror that bulges towards the ray turns the reflected rays of the beam apart by twice the angle
+// its normal turns across the beam.
+inline void reflect_cone(const ray& ray_in, const hit_record& hit_rec, ray& scattered) {
+    scattered.cone_width = hit_rec.cone_width;
+    scattered.cone_spread = ray_in.cone_spread + 2 * hit_rec.curvature * hit_rec.cone_width;
+}
+
+// Refraction with refraction_ratio = eta_in / eta_out scales the angles between the rays of the beam by
+// eta * cos(incidence) / cos(refraction), and a curved surface bends them towards each other (for a surface
+// bulging into a denser medium) or apart, as a lens does.
+inline void refract_cone(const ray& ray_in, const hit_record& hit_rec, double refraction_ratio, ray& scattered) {
+    double cos_in = std::fabs(dot(unit(ray_in.direction), hit_rec.normal));
+    double cos_out = sqrt(std::fmax(1.0 - refraction_ratio * refraction_ratio * (1.0 - cos_in * cos_in), 1e-6));
+    double scale = refraction_ratio * cos_in / cos_out;
+    scattered.cone_width = hit_rec.cone_width;
+    scattered.cone_spread = real(scale * ray_in.cone_spread - (1 - scale) * hit_rec.curvature * hit_rec.cone_width);
+}
+
 // Abstract class definition for materials
 class material  {
 public:
     virtual bool scatter(const ray& ray_in, const hit_record& hit_rec, color3& attenuation, ray& scattered_light) const = 0;
+    virtual material_type type() const = 0;
+    // type of the texture the material samples in scatter(), if any
+    virtual texture_type surface_texture_type() const { return texture_type::none; }
 };
 
 // Class definition for lambertian/diffuse/matte style materials
 class lambertian : public material  {
 public:
-    lambertian(const color3& albedo) : tex(make_shared<solid_color>(albedo)) {}
-    lambertian(shared_ptr<texture> tex) : tex(tex) {}
+    // a plain colour is kept inside the material, so it needs no entry in the texture table
+    lambertian(const color3& albedo) : albedo(albedo), tex(&this->albedo) {}
+    lambertian(const texture* tex) : albedo(color3(0, 0, 0)), tex(tex) {}
+    // tex may point at our own albedo
+    lambertian(const lambertian&) = delete;
+    lambertian& operator=(const lambertian&) = delete;
 //    color3 albedo;
     virtual bool scatter(const ray& ray_in, const hit_record& hit_rec, color3& attenuation, ray& scattered_light) const override    {
         const auto timestamp = ray_in.timestamp;
@@ -29,11 +69,17 @@ public:
         if (scatter_direction.near_zero())  scatter_direction = hit_rec.normal;
         point3 origin = hit_rec.point;
         scattered_light = ray(origin, scatter_direction, timestamp);
-        attenuation = tex->value(hit_rec.u, hit_rec.v, hit_rec.point);
+        // the diffuse lobe is sampled one ray at a time; the cone just keeps widening as it did before
+        scattered_light.cone_width = hit_rec.cone_width;
+        scattered_light.cone_spread = ray_in.cone_spread;
+        attenuation = tex->value(hit_rec.u, hit_rec.v, hit_rec.point, hit_rec.footprint);
         return true;
     }
+    material_type type() const override { return material_type::lambertian; }
+    texture_type surface_texture_type() const override { return tex->type(); }
 private:
-    shared_ptr<texture> tex;
+    solid_color albedo;
+    const texture* tex;
 };
 
 // Class definition for metallic/perfectly reflective materials
@@ -47,9 +93,11 @@ public:
         point3 origin = hit_rec.point;
         vec3 direction = reflected + fuzz * random_in_unit_sphere();
         scattered_light = ray(origin, direction, ray_in.timestamp);
+        reflect_cone(ray_in, hit_rec, scattered_light);
         attenuation = albedo;
         return (dot(scattered_light.direction, hit_rec.normal) > 0);
     }
+    material_type type() const override { return material_type::metal; }
 };
 
 //Class definition for dielectric (clear/translucent) materials (e.g. glass, diamond etc.)
@@ -65,7 +113,8 @@ public:
         vec3 direction;
         vec3 unit_direction = unit(ray_in.direction);
         bool no_refraction = refraction_ratio * sin_theta > 1.0;
-        if (no_refraction || reflectance(cos_theta, refraction_ratio) > random_double())
+        bool reflected = no_refraction || reflectance(cos_theta, refraction_ratio) > random_double();
+        if (reflected)
             // reflection must occur
             direction = reflect(unit_direction, hit_rec.normal);
         else
@@ -73,15 +122,18 @@ public:
             direction = refract(unit_direction, hit_rec.normal, refraction_ratio);
         point3 point = hit_rec.point;
         scattered_light = ray(point, direction, ray_in.timestamp);
+        if (reflected) reflect_cone(ray_in, hit_rec, scattered_light);
+        else refract_cone(ray_in, hit_rec, refraction_ratio, scattered_light);
         return true;
     }
+    material_type type() const override { return material_type::dielectric; }
 private:
     static double reflectance(double cos, double eta)   {
         // Christophe Schlick's polynomial approximation for when and how much a dielectric reflects
         // Source: https://en.wikipedia.org/wiki/Schlick%27s_approximation
         auto r0 = (1 - eta) / (1 + eta);
         r0 *= r0;
-        return r0 + (1 - r0) * pow(1 - cos, 5);
+        return r0 + (1 - r0) * (fast_math_mode() ? fast_pow5(1 - cos) : pow(1 - cos, 5));
     }
 };
 
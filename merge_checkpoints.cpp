@@ -0,0 +1,89 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+// lumina_merge: adds up the samples of independent checkpoints of the same scene (rendered with different
+// --seed values, e.g. on different machines) and writes the combined result, either as a checkpoint or as
+// an image.
+
+#include <lumina.h>
+
+#include <checkpoint.h>
+#include <framebuffer.h>
+#include <image_io.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+void print_usage(const char* program) {
+    std::cerr << "usage: " << program << " [--tonemap clamp|reinhard] OUTPUT CHECKPOINT...\n"
+              << "  OUTPUT is an image (.ppm, .pfm or .png) or, with any other extension, the merged checkpoint\n";
+}
+
+int main(int argc, char* argv[]) {
+    display_transform display;
+    std::vector<std::string> paths;
+    for (int arg = 1; arg < argc; arg++) {
+        std::string option = argv[arg];
+        if (option == "--tonemap" && arg + 1 < argc) {
+            std::string name = argv[++arg];
+            if (name == "clamp") display.tonemap = tonemap_operator::clamp;
+            else if (name == "reinhard") display.tonemap = tonemap_operator::reinhard;
+            else {
+                std::cerr << "Unknown tonemap operator '" << name << "'.\n";
+                return 1;
+            }
+        } else if (option == "--help" || option == "-h") {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            paths.push_back(option);
+        }
+    }
+    if (paths.size() < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const std::string& output_path = paths[0];
+
+    framebuffer total(0, 0);
+    checkpoint_info merged;
+    std::set<uint64_t> seeds;
+    for (size_t i = 1; i < paths.size(); i++) {
+        framebuffer image(0, 0);
+        checkpoint_info info;
+        if (!load_checkpoint(paths[i], image, info)) return 1;
+        if (i == 1) {
+            total = image;
+            merged = info;
+        } else {
+            if (info.width != merged.width || info.height != merged.height || info.config != merged.config) {
+                std::cerr << "'" << paths[i] << "' does not match '" << paths[1] << "':\n  " << info.width << "x"
+                          << info.height << " " << info.config << "\n  " << merged.width << "x" << merged.height
+                          << " " << merged.config << "\n";
+                return 1;
+            }
+            total.merge(image);
+        }
+        // two renders with the same seed drew the same samples, so adding them up would not reduce noise
+        if (info.merged || !seeds.insert(info.seed).second) {
+            std::cerr << "'" << paths[i] << "' may share samples with another input (same seed, or already merged).\n";
+            return 1;
+        }
+        std::clog << paths[i] << ": seed " << info.seed << ", "
+                  << double(image.total_samples()) / (double(image.width()) * image.height()) << " samples per pixel\n";
+    }
+    merged.merged = paths.size() > 2;
+
+    std::clog << "Merged: " << double(total.total_samples()) / (double(total.width()) * total.height())
+              << " samples per pixel\n";
+    image_format format;
+    if (image_format_from_path(output_path, format)) {
+        if (!write_image(output_path, total.resolve(), display)) return 1;
+    } else {
+        if (!save_checkpoint(output_path, total, merged)) return 1;
+    }
+    std::clog << "Wrote " << output_path << "\n";
+    return 0;
+}
@@ -61,22 +61,48 @@ public:
         return perlin_interp(c, u, v, w);
     }
 
-    double turb(const point3& p, int depth) const {
+    // |sum| of depth octaves of noise. Given the width of the area the value stands for, octaves whose
+    // lattice is finer than that are left out (the last one kept fading out smoothly, as in pbrt's FBm), and
+    // the result is the expected |sum| over the area: the octaves left out are treated as Gaussian noise of
+    // the same variance, which keeps the average brightness of the texture where a plain cutoff would
+    // darken it.
+    double turb(const point3& p, int depth, double footprint = 0) const {
         auto accum = 0.0;
         auto temp_p = p;
         auto weight = 1.0;
 
-        for (int i = 0; i < depth; i++) {
+        double octaves = depth;
+        if (footprint > 0) octaves = std::fmin(std::fmax(-std::log2(footprint), 0.0), double(depth));
+        int whole_octaves = int(octaves);
+        for (int i = 0; i < whole_octaves; i++) {
             accum += weight * noise(temp_p);
             weight *= 0.5;
             temp_p *= 2;
         }
-
-        return std::fabs(accum);
+        if (whole_octaves == depth) return std::fabs(accum);
+
+        // smoothstep from 0.3 to 0.7
+        double t = std::fmin(std::fmax((octaves - whole_octaves - 0.3) / 0.4, 0.0), 1.0);
+        t = t * t * (3 - 2 * t);
+        if (t > 0) accum += t * weight * noise(temp_p);
+        double dropped_variance = (1 - t) * (1 - t) * weight * weight;
+        for (int i = whole_octaves + 1; i < depth; i++) {
+            weight *= 0.5;
+            dropped_variance += weight * weight;
+        }
+        double sigma = noise_sigma * std::sqrt(dropped_variance);
+        // nothing (or next to nothing) left out, e.g. a fully faded-in last octave; the formula below would
+        // be 0/0 where accum is 0, as it is at every lattice point
+        if (sigma < 1e-12) return std::fabs(accum);
+        // E|accum + X| for X ~ N(0, sigma^2)
+        return sigma * std::sqrt(2 / pi) * std::exp(-accum * accum / (2 * sigma * sigma))
+               + accum * std::erf(accum / (sigma * std::sqrt(2.0)));
     }
 
 private:
     static const int point_count = 256;
+    // standard deviation of noise() over space, measured
+    static constexpr double noise_sigma = 0.18;
     vec3 randvec[point_count]; // replace float points with unit vectors.
 //    double randfloat[point_count];
     int perm_x[point_count];
@@ -8,17 +8,62 @@
 #include <lumina.h>
 #include <vec3.h>
 
+// Rays carry a ray cone: an isotropic ray differential that describes the neighbouring rays (those of the
+// adjacent pixels, for a camera ray) by the width of the beam at the origin and the rate at which it grows
+// per unit of distance travelled. Textures use the resulting footprint to pick a level of detail (see
+// texture_footprint). A width and spread of zero, the default, is a point sample at the finest detail.
 class ray   {
 public:
     vec3 origin;
     vec3 direction;
-    double timestamp;
+    real timestamp;
+    // beam width at the origin, and its growth per unit distance (an angle in radians); both are signed, a
+    // negative spread being a beam that converges (after a curved mirror or lens)
+    real cone_width = 0;
+    real cone_spread = 0;
 
     ray() {}
-    ray(const point3 &origin, const vec3 &direction, const double timestamp): origin(origin), direction(direction), timestamp(timestamp)   {}
+    ray(const point3 &origin, const vec3 &direction, const real timestamp): origin(origin), direction(direction), timestamp(timestamp)   {}
     ray(const point3 &origin, const vec3 &direction): origin(origin), direction(direction), timestamp(0) {}
 
-    point3 at(const double t) const  { return origin + direction * t; }
+    point3 at(const real t) const  { return origin + direction * t; }
+
+    bool has_cone() const { return cone_width != 0 || cone_spread != 0; }
+    // signed beam width at parameter t
+    real cone_width_at(const real t) const { return cone_width + cone_spread * t * direction.length(); }
+};
+
+// Texture level-of-detail switch (--texture-lod); set once before rendering starts. When off, camera rays
+// carry no cone and every texture lookup is a point sample.
+inline bool& texture_lod_mode() {
+    static bool enabled = true;
+    return enabled;
+}
+
+// Area of the surface a texture lookup stands for: the width of the ray cone where it meets the surface,
+// in scene units and in texture coordinates along u and v. Zero means a point sample.
+struct texture_footprint {
+    real world = 0;
+    real u = 0;
+    real v = 0;
+};
+
+// A ray prepared for BVH traversal: the reciprocal of the direction and the sign of each direction
+// component are computed once per ray instead of once per visited box. A zero component counts as +0
+// (reciprocal +inf), whatever its sign bit; aabb::hit relies on that.
+class traversal_ray {
+public:
+    point3 origin;
+    vec3 inverse_direction;
+    // 1 where the direction component is negative
+    int sign[3];
+
+    explicit traversal_ray(const ray& r) : origin(r.origin),
+        inverse_direction(1.0 / (r.direction.x + 0.0), 1.0 / (r.direction.y + 0.0), 1.0 / (r.direction.z + 0.0)) {
+        sign[0] = inverse_direction.x < 0;
+        sign[1] = inverse_direction.y < 0;
+        sign[2] = inverse_direction.z < 0;
+    }
 };
 
 #endif //LUMINA_RAY_H
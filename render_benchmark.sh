@@ -0,0 +1,91 @@
+#!/bin/sh
+#
+# Created by Anchit Mishra on 2026-10-18.
+#
+# Renders every shipped scene at a fixed seed and resolution for a series of time budgets and reports, as
+# CSV on stdout, the error (RMSE of display values in [0, 1]) reached within each budget against a high-spp
+# reference, along with render time, throughput and peak memory. Renderer versions are compared by the
+# error they reach per second rather than by speed alone.
+#
+# The references are rendered once (with the default settings, at another seed) and kept in
+# <build directory>/reference under the renderer version (see renderer_version in checkpoint.h), so a build
+# that draws scenes differently renders new ones, and Lumina rejects a reference from another version. A
+# reference has noise of its own, so errors well below its level (roughly that of a REFERENCE_SPP render)
+# are not meaningful.
+# Budgets count from start-up, so scene and BVH construction are part of the time. rays_per_s is only
+# reported by Lumina builds with LUMINA_STATS (whose counters cost some speed); samples_per_s counts
+# camera paths.
+#
+# usage: ./render_benchmark.sh [build directory] [extra Lumina options...]
+# e.g.   ./render_benchmark.sh build --integrator path
+# environment: WIDTH (default 200), BUDGETS (seconds, default 1,2,4,8), SEED (default 0),
+#              REFERENCE_SPP (default 1024)
+
+build_dir=${1:-build}
+[ $# -gt 0 ] && shift
+options=$*
+width=${WIDTH:-200}
+budgets=${BUDGETS:-1,2,4,8}
+seed=${SEED:-0}
+reference_spp=${REFERENCE_SPP:-1024}
+reference_seed=$((seed + 1000))
+# textured_globe loads its texture from here (see lumina_image)
+LUMINA_IMAGES=${LUMINA_IMAGES:-$(cd "$(dirname "$0")" && pwd)/images}
+export LUMINA_IMAGES
+scenes="cover_scene_book_one bouncing_balls_with_texture checkered_spheres textured_globe perlin_spheres"
+
+if [ ! -x "$build_dir/Lumina" ]; then
+    echo "$build_dir/Lumina not found; build it first" >&2
+    exit 1
+fi
+build_dir=$(cd "$build_dir" && pwd)
+version=$("$build_dir/Lumina" --version | sed -n 's/^Lumina renderer version \([0-9]*\)$/\1/p')
+if [ -z "$version" ]; then
+    echo "$build_dir/Lumina does not report a renderer version" >&2
+    exit 1
+fi
+reference_dir="$build_dir/reference"
+mkdir -p "$reference_dir"
+
+work_dir=$(mktemp -d)
+trap 'rm -rf "$work_dir"' EXIT
+
+# value of the first log line matching a sed expression
+field() {
+    sed -n "$1" "$work_dir/log" | head -n 1
+}
+
+echo "scene,width,budget_s,time_s,samples_per_pixel,rmse,render_time_s,total_time_s,samples_per_s,rays_per_s,peak_memory_mb"
+for scene in $scenes; do
+    reference="$reference_dir/${scene}_${width}_${reference_spp}_v${version}.ckpt"
+    if [ ! -f "$reference" ]; then
+        echo "Rendering reference $reference..." >&2
+        (cd "$work_dir" && "$build_dir/Lumina" --scene "$scene" --width "$width" --spp "$reference_spp" \
+            --seed "$reference_seed" --checkpoint "$reference" > /dev/null 2>&1) || {
+            echo "Could not render the reference for $scene" >&2
+            exit 1
+        }
+    fi
+
+    echo "Measuring $scene..." >&2
+    (cd "$work_dir" && "$build_dir/Lumina" --scene "$scene" --width "$width" --spp 1000000 --seed "$seed" \
+        --reference "$reference" --time-budgets "$budgets" $options 2>&1 | tr '\r' '\n' > "$work_dir/log")
+    render_time=$(field 's/^Render time: \([0-9.e+-]*\) s$/\1/p')
+    samples=$(field 's/^Samples taken: \([0-9]*\) .*/\1/p')
+    rays=$(field 's/^Rays traced: \([0-9]*\),.*/\1/p')
+    total_time=$(field 's/^Total time: \([0-9.e+-]*\) s, .*/\1/p')
+    memory=$(field 's/.*peak memory: \([0-9.e+-]*\) MB$/\1/p')
+    if [ -z "$render_time" ]; then
+        echo "Lumina failed on $scene:" >&2
+        cat "$work_dir/log" >&2
+        exit 1
+    fi
+    rates=$(awk -v t="$render_time" -v s="$samples" -v r="$rays" \
+        'BEGIN { printf "%.0f,%s", s / t, (r == "" ? "" : sprintf("%.0f", r / t)) }')
+
+    # "Error at 1 s: RMSE 0.03, 27 samples per pixel after 0.97 s"
+    sed -n 's/^Error at \([0-9.e+-]*\) s: RMSE \([0-9.e+-]*\), \([0-9.e+-]*\) samples per pixel after \([0-9.e+-]*\) s$/\1,\4,\3,\2/p' \
+        "$work_dir/log" | while read -r row; do
+        echo "$scene,$width,$row,$render_time,$total_time,$rates,$memory"
+    done
+done
@@ -0,0 +1,189 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_RENDERER_H
+#define LUMINA_RENDERER_H
+
+#include <lumina.h>
+#include <camera.h>
+#include <framebuffer.h>
+#include <hittable.h>
+#include <integrator.h>
+#include <stats.h>
+#include <thread_pool.h>
+#include <wavefront.h>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+struct render_settings {
+    int image_width = 900;
+    int image_height = 506;
+    int samples_per_pixel = 50;
+    // only used by the recursive integrator; the path integrator terminates by Russian roulette
+    int max_depth = 50;
+    integrator_type integrator = integrator_type::recursive;
+    // 0 picks one thread per hardware thread
+    int thread_count = 0;
+    // edge length of the square tiles handed to the scheduler, in pixels
+    int tile_size = 16;
+    // adaptive sampling: every pixel takes at least min_samples_per_pixel and at most samples_per_pixel
+    // samples, and stops early once its estimated display-space noise drops below noise_threshold
+    bool adaptive = false;
+    int min_samples_per_pixel = 16;
+    int adaptive_batch_size = 8;
+    double noise_threshold = 0.01;
+    // wavefront mode traces tiles as batches of paths sorted by material (see wavefront.h); it always uses
+    // Russian roulette like the path integrator and does not combine with adaptive sampling
+    bool wavefront = false;
+    int wavefront_batch_size = 16384;
+};
+
+// Division of an image into square tiles, numbered row by row from the top left.
+struct tile_grid {
+    int image_width;
+    int image_height;
+    int tile_size;
+    int tiles_x;
+    int tiles_y;
+
+    tile_grid(int width, int height, int tile_size)
+        : image_width(width), image_height(height), tile_size(tile_size),
+          tiles_x((width + tile_size - 1) / tile_size), tiles_y((height + tile_size - 1) / tile_size) {}
+
+    int count() const { return tiles_x * tiles_y; }
+
+    // pixel rectangle [x0, x1) x [y0, y1) of a tile
+    void bounds(int tile_index, int& x0, int& y0, int& x1, int& y1) const {
+        x0 = (tile_index % tiles_x) * tile_size;
+        y0 = (tile_index / tiles_x) * tile_size;
+        x1 = std::min(x0 + tile_size, image_width);
+        y1 = std::min(y0 + tile_size, image_height);
+    }
+};
+
+// Splits the image into square tiles and renders them on a work-stealing thread pool.
+class renderer {
+public:
+    renderer(const render_settings& settings)
+        : settings(settings), pool(settings.thread_count),
+          tiles(settings.image_width, settings.image_height, settings.tile_size) {
+        if (settings.wavefront) {
+            // one set of wave buffers per worker, reused across tiles
+            wavefront_tracers.assign(pool.size(), wavefront_tracer(settings.wavefront_batch_size));
+        }
+    }
+
+    int thread_count() const { return pool.size(); }
+    int tile_count() const { return tiles.count(); }
+    const tile_grid& grid() const { return tiles; }
+
+    // Render until every pixel has min(samples_per_pixel, sample_limit) samples, or has converged in adaptive
+    // mode. Pixels continue from the samples already in image, so rendering in passes of increasing limits
+    // (or resuming from a checkpoint) gives the same result as a single call.
+    void render(const hittable& world, const camera& cam, framebuffer& image,
+                int sample_limit = std::numeric_limits<int>::max()) {
+        int tiles_done = 0;
+        std::mutex progress_mutex;
+        int total_tiles = tile_count();
+
+        pool.run(total_tiles, [&](size_t tile_index, int worker_index) {
+            render_tile(world, cam, image, int(tile_index), worker_index, sample_limit);
+            global_stats::flush_thread_stats();
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            std::clog << "\rTiles remaining: " << (total_tiles - ++tiles_done) << "   " << std::flush;
+        });
+        std::clog << '\n';
+    }
+
+    // Render one tile completely on the calling thread (see distributed.h).
+    void render_single_tile(const hittable& world, const camera& cam, framebuffer& image, int tile_index) {
+        render_tile(world, cam, image, tile_index, 0, std::numeric_limits<int>::max());
+        global_stats::flush_thread_stats();
+    }
+
+private:
+    render_settings settings;
+    thread_pool pool;
+    tile_grid tiles;
+    std::vector<wavefront_tracer> wavefront_tracers;
+
+    color3 radiance(const ray& r, const hittable& world) const {
+        if (settings.integrator == integrator_type::path) return path_color(r, world);
+        return ray_color(r, world, settings.max_depth);
+    }
+
+    void render_tile(const hittable& world, const camera& cam, framebuffer& image, int tile_index, int worker_index,
+                     int sample_limit) {
+        const int image_width = settings.image_width;
+        const int image_height = settings.image_height;
+        int x0, y0, x1, y1;
+        tiles.bounds(tile_index, x0, y0, x1, y1);
+        int sample_cap = std::min(settings.samples_per_pixel, sample_limit);
+
+        if (settings.wavefront) {
+            // without adaptive sampling all pixels of a tile always hold the same number of samples
+            int first_sample = image.pixel(x0, y0).sample_count;
+            if (first_sample < sample_cap) {
+                pixel_cost before = stats_enabled ? thread_traversal_stats().cost() : pixel_cost();
+                wavefront_tracers[worker_index].render_tile(world, cam, image, x0, y0, x1, y1, first_sample, sample_cap);
+                // paths of the whole tile are traced together, so their cost is shared out evenly
+                if (stats_enabled) spread_cost(image, x0, y0, x1, y1, thread_traversal_stats().cost() - before);
+            }
+            return;
+        }
+
+        random_stream& rng = thread_random_stream();
+        for (int y = y0; y < y1; y++) {
+            // framebuffer rows run top to bottom, camera v runs bottom to top
+            int j = image_height - 1 - y;
+            for (int i = x0; i < x1; i++) {
+                pixel_accumulator& pixel = image.pixel(i, y);
+                pixel_cost cost_before = stats_enabled ? thread_traversal_stats().cost() : pixel_cost();
+                uint64_t pixel_index = uint64_t(y) * image_width + i;
+                int target = settings.adaptive ? std::min(settings.min_samples_per_pixel, settings.samples_per_pixel)
+                                               : settings.samples_per_pixel;
+                if (target < pixel.sample_count) {
+                    // adaptive mode checks the noise after min_samples_per_pixel samples and then after every
+                    // adaptive_batch_size more; a pixel from an earlier pass continues at its next check
+                    int batch = settings.adaptive_batch_size;
+                    int batches = (pixel.sample_count - target + batch - 1) / batch;
+                    target = std::min(target + batches * batch, settings.samples_per_pixel);
+                }
+                while (true) {
+                    for (int s = pixel.sample_count; s < std::min(target, sample_cap); ++s) {
+                        rng.seed(pixel_index, s);
+                        // multiple samples for anti-aliasing
+                        ray r = camera_sample_ray(cam, i, j, image_width, image_height);
+                        uint64_t rays_before = stats_enabled ? thread_traversal_stats().rays : 0;
+                        pixel.add(radiance(r, world));
+                        // the rays this sample traced are the length of its path
+                        if (stats_enabled) {
+                            traversal_stats& stats = thread_traversal_stats();
+                            stats.path_lengths[path_length_bin(stats.rays - rays_before)]++;
+                        }
+                    }
+                    if (target >= sample_cap || pixel.display_error() <= settings.noise_threshold) break;
+                    target = std::min(target + settings.adaptive_batch_size, settings.samples_per_pixel);
+                }
+                if (stats_enabled) image.cost(i, y) += thread_traversal_stats().cost() - cost_before;
+            }
+        }
+    }
+
+    static void spread_cost(framebuffer& image, int x0, int y0, int x1, int y1, const pixel_cost& total) {
+        uint64_t pixel_count = uint64_t(x1 - x0) * (y1 - y0);
+        pixel_cost share;
+        share.rays = total.rays / pixel_count;
+        share.bvh_nodes_visited = total.bvh_nodes_visited / pixel_count;
+        share.aabb_tests = total.aabb_tests / pixel_count;
+        share.primitive_tests = total.primitive_tests / pixel_count;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) image.cost(x, y) += share;
+        }
+    }
+};
+
+#endif //LUMINA_RENDERER_H
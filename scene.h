@@ -0,0 +1,54 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_SCENE_H
+#define LUMINA_SCENE_H
+
+#include <camera.h>
+#include <hittable_list.h>
+#include <material.h>
+#include <texture.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Owner of the objects of one type (materials, textures) used by a scene. make() returns a plain pointer
+// that stays valid for the lifetime of the table, so primitives, materials and hit records can refer to
+// entries without shared_ptr reference counting.
+template <typename T>
+class resource_table {
+public:
+    template <typename U, typename... Args>
+    const U* make(Args&&... args) {
+        std::unique_ptr<U> item(new U(std::forward<Args>(args)...));
+        const U* handle = item.get();
+        items.push_back(std::move(item));
+        return handle;
+    }
+
+    size_t size() const { return items.size(); }
+
+private:
+    std::vector<std::unique_ptr<T>> items;
+};
+
+using material_table = resource_table<material>;
+using texture_table = resource_table<texture>;
+
+// A scene owns its textures and materials alongside the objects that use them, and says where the camera
+// looks from. Members are destroyed in reverse order, so the objects go first and the textures last.
+struct scene {
+    texture_table textures;
+    material_table materials;
+    // blocks of primitives that objects points into without owning them (see scene_file.h), so that
+    // millions of objects cost no reference counting
+    std::vector<shared_ptr<const void>> primitive_blocks;
+    hittable_list objects;
+    camera_settings view;
+    // objects is already a single BVH (see scene_cache.h), so none is built over it
+    bool prebuilt_bvh = false;
+};
+
+#endif //LUMINA_SCENE_H
@@ -0,0 +1,459 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_SCENE_CACHE_H
+#define LUMINA_SCENE_CACHE_H
+
+#include <lumina.h>
+#include <bvh.h>
+#include <hittable.h>
+#include <hittable_list.h>
+#include <linear_bvh.h>
+#include <moving_sphere.h>
+#include <scene.h>
+#include <scene_file.h>
+#include <sphere.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LUMINA_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Binary cache of a scene file (see scene_file.h), so that repeated renders of a large scene skip parsing
+// and BVH construction. A cache file holds the spheres as flat records in BVH leaf order, the flattened BVH
+// itself (linear_bvh_node), and the texture and material statements of the scene file. Renders map the file
+// and trace the spheres and nodes in place; only the handful of textures and materials are rebuilt, by
+// replaying their statements, since they hold pointers and loaded images.
+//
+// Cache files are named after a key made of a hash of the scene file's contents, the cache version, the
+// precision of `real` and the BVH build options, so an edited scene or different options simply miss.
+// Nothing is ever deleted from the cache directory.
+//
+// Layout, in native byte order, every section starting at a multiple of 64 bytes:
+//   scene_cache_header
+//   texture and material statements, one per line
+//   cached_sphere[sphere_count]
+//   cached_sphere_motion[motion_count]
+//   linear_bvh_node[node_count]
+
+constexpr uint32_t scene_cache_version = 1;
+constexpr uint32_t scene_cache_no_motion = 0xFFFFFFFFu;
+
+struct scene_cache_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t real_size;
+    uint64_t key;
+    uint64_t file_size;
+    uint64_t resources_offset, resources_size;
+    uint64_t spheres_offset, sphere_count;
+    uint64_t motions_offset, motion_count;
+    uint64_t nodes_offset, node_count;
+    uint64_t material_count;
+    // scene bounds, min and max per axis
+    double bounds[6];
+};
+
+struct cached_sphere {
+    double centre[3];
+    double radius;
+    // index into the materials in the order the scene file defines them
+    uint32_t material;
+    // index of the motion of a moving sphere (whose centre is then the start centre), or scene_cache_no_motion
+    uint32_t motion;
+};
+
+struct cached_sphere_motion {
+    double stop_centre[3];
+    double start_time, stop_time;
+};
+
+static_assert(sizeof(cached_sphere) == 40, "cached_sphere is part of the cache file layout");
+static_assert(sizeof(cached_sphere_motion) == 40, "cached_sphere_motion is part of the cache file layout");
+
+// A whole file, read-only: mapped where mmap is available, read into memory otherwise.
+class mapped_file {
+public:
+    mapped_file() {}
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef LUMINA_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = size_t(info.st_size);
+        if (length > 0) {
+            void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            bytes = static_cast<const uint8_t*>(mapping);
+            mapped = true;
+        }
+        ::close(fd);
+        return true;
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return false;
+        std::fseek(file, 0, SEEK_END);
+        long end = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        // uint64_t words keep the records in the buffer aligned
+        buffer.resize((size_t(end) + 7) / 8);
+        length = size_t(end);
+        bool ok = std::fread(buffer.data(), 1, length, file) == length;
+        std::fclose(file);
+        bytes = reinterpret_cast<const uint8_t*>(buffer.data());
+        return ok;
+#endif
+    }
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<uint64_t> buffer;
+
+    void close() {
+#ifdef LUMINA_HAS_MMAP
+        if (mapped) ::munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+        mapped = false;
+        bytes = nullptr;
+        length = 0;
+        std::vector<uint64_t>().swap(buffer);
+    }
+};
+
+// Hash of a block of bytes, eight at a time; fast enough that hashing a scene file costs far less than
+// parsing it.
+inline uint64_t scene_cache_hash(const uint8_t* data, size_t size, uint64_t hash = 0x243F6A8885A308D3ull) {
+    auto mix = [&hash](uint64_t word) {
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        mix(word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    mix(tail);
+    mix(size);
+    return hash;
+}
+
+inline uint64_t scene_cache_key(const uint8_t* scene_data, size_t scene_size, const bvh_build_options& options) {
+    uint64_t hash = scene_cache_hash(scene_data, scene_size);
+    double costs[2] = { options.traversal_cost, options.intersection_cost };
+    uint32_t settings[5] = { scene_cache_version, uint32_t(sizeof(real)), uint32_t(options.method),
+                             uint32_t(options.max_leaf_size), uint32_t(options.sah_bins) };
+    hash = scene_cache_hash(reinterpret_cast<const uint8_t*>(costs), sizeof(costs), hash);
+    return scene_cache_hash(reinterpret_cast<const uint8_t*>(settings), sizeof(settings), hash);
+}
+
+// The spheres and BVH of a cache file, traced where they lie in the mapping.
+class cached_scene : public hittable {
+public:
+    // file must hold a cache that passed scene_cache_valid(); materials are those of the replayed
+    // statements, in definition order.
+    cached_scene(std::unique_ptr<mapped_file> file, std::vector<const material*> materials)
+        : file(std::move(file)), materials(std::move(materials)) {
+        const uint8_t* data = this->file->data();
+        const scene_cache_header& header = *reinterpret_cast<const scene_cache_header*>(data);
+        spheres = reinterpret_cast<const cached_sphere*>(data + header.spheres_offset);
+        motions = reinterpret_cast<const cached_sphere_motion*>(data + header.motions_offset);
+        nodes = reinterpret_cast<const linear_bvh_node*>(data + header.nodes_offset);
+        node_count = header.node_count;
+        sphere_count = header.sphere_count;
+        const double* b = header.bounds;
+        bbox = aabb(interval(b[0], b[3]), interval(b[1], b[4]), interval(b[2], b[5]));
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (node_count == 0) return false;
+        return linear_bvh_closest_hit(nodes, r, ray_t, rec, [&](uint32_t index, const interval& t) {
+            LUMINA_COUNT(primitive_tests);
+            if (!sphere_root(centre(spheres[index], r.timestamp), spheres[index].radius, r, t, rec.root)) return false;
+            rec.object = this;
+            rec.primitive_id = index;
+            return true;
+        });
+    }
+
+    // Matches sphere::finalize and moving_sphere::finalize.
+    void finalize(const ray& r, hit_record& rec) const override {
+        const cached_sphere& s = spheres[rec.primitive_id];
+        rec.point = r.at(rec.root);
+        vec3 outward_normal = (rec.point - centre(s, r.timestamp)) / s.radius;
+        rec.set_face_normal(r, outward_normal);
+        set_sphere_cone(r, s.radius, rec);
+        if (s.motion == scene_cache_no_motion) sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.material_ptr = materials[s.material];
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t size() const { return size_t(sphere_count); }
+    size_t nodes_in_tree() const { return size_t(node_count); }
+
+private:
+    std::unique_ptr<mapped_file> file;
+    std::vector<const material*> materials;
+    const cached_sphere* spheres;
+    const cached_sphere_motion* motions;
+    const linear_bvh_node* nodes;
+    uint64_t node_count;
+    uint64_t sphere_count;
+    aabb bbox;
+
+    point3 centre(const cached_sphere& s, double time) const {
+        point3 start(s.centre[0], s.centre[1], s.centre[2]);
+        if (s.motion == scene_cache_no_motion) return start;
+        const cached_sphere_motion& m = motions[s.motion];
+        return moving_sphere_centre(start, point3(m.stop_centre[0], m.stop_centre[1], m.stop_centre[2]), m.start_time,
+                                    m.stop_time, time);
+    }
+};
+
+// Checks everything a cached_scene relies on, so that a truncated or foreign file is rebuilt instead of
+// read out of bounds.
+inline bool scene_cache_valid(const mapped_file& file, uint64_t key) {
+    if (file.size() < sizeof(scene_cache_header)) return false;
+    const scene_cache_header& header = *reinterpret_cast<const scene_cache_header*>(file.data());
+    if (std::memcmp(header.magic, "LUMSCN\0\0", 8) != 0 || header.version != scene_cache_version
+        || header.real_size != sizeof(real) || header.key != key || header.file_size != file.size()) {
+        return false;
+    }
+    auto section_fits = [&](uint64_t offset, uint64_t count, uint64_t record_size) {
+        return offset % 64 == 0 && offset <= file.size() && count <= (file.size() - offset) / record_size;
+    };
+    if (!section_fits(header.resources_offset, header.resources_size, 1)
+        || !section_fits(header.spheres_offset, header.sphere_count, sizeof(cached_sphere))
+        || !section_fits(header.motions_offset, header.motion_count, sizeof(cached_sphere_motion))
+        || !section_fits(header.nodes_offset, header.node_count, sizeof(linear_bvh_node))
+        || header.node_count >= 0xFFFFFFFFu || header.sphere_count >= 0xFFFFFFFFu) {
+        return false;
+    }
+    const cached_sphere* spheres = reinterpret_cast<const cached_sphere*>(file.data() + header.spheres_offset);
+    for (uint64_t i = 0; i < header.sphere_count; i++) {
+        if (spheres[i].material >= header.material_count) return false;
+        if (spheres[i].motion != scene_cache_no_motion && spheres[i].motion >= header.motion_count) return false;
+    }
+    // children come after their parent, which also rules out cycles and means that a node's depth is known
+    // by the time it is reached; no interior node may be deeper than the traversal stack allows
+    const linear_bvh_node* nodes = reinterpret_cast<const linear_bvh_node*>(file.data() + header.nodes_offset);
+    std::vector<uint8_t> depth(size_t(header.node_count), 0);
+    for (uint64_t i = 0; i < header.node_count; i++) {
+        const linear_bvh_node& node = nodes[i];
+        if (node.primitive_count > 0) {
+            if (uint64_t(node.offset) + node.primitive_count > header.sphere_count) return false;
+        } else if (node.offset <= i + 1 || node.offset >= header.node_count || node.axis > 2
+                   || depth[i] >= linear_bvh_max_depth) {
+            return false;
+        } else {
+            uint8_t child_depth = uint8_t(depth[i] + 1);
+            depth[i + 1] = std::max(depth[i + 1], child_depth);
+            depth[node.offset] = std::max(depth[node.offset], child_depth);
+        }
+    }
+    return true;
+}
+
+// Writes the cache of a parsed scene file whose objects bvh was built over. Returns false if the scene
+// holds anything but spheres and moving spheres, or if the file cannot be written.
+inline bool write_scene_cache(const std::string& path, uint64_t key, const scene_file_reader& reader,
+                              const linear_bvh& bvh) {
+    std::vector<cached_sphere> spheres;
+    std::vector<cached_sphere_motion> motions;
+    const std::vector<const material*>& materials = reader.material_definitions();
+    auto material_index = [&materials](const material* m) {
+        return uint32_t(std::find(materials.begin(), materials.end(), m) - materials.begin());
+    };
+    spheres.reserve(bvh.primitive_array().size());
+    // consecutive spheres usually share a material
+    const material* last_material = nullptr;
+    uint32_t last_index = 0;
+    for (const hittable* object : bvh.primitive_array()) {
+        cached_sphere record;
+        const material* m;
+        point3 centre;
+        if (const sphere* s = dynamic_cast<const sphere*>(object)) {
+            centre = s->centre;
+            record.radius = s->radius;
+            record.motion = scene_cache_no_motion;
+            m = s->material_ptr;
+        } else if (const moving_sphere* s = dynamic_cast<const moving_sphere*>(object)) {
+            centre = s->start_centre;
+            record.radius = s->radius;
+            record.motion = uint32_t(motions.size());
+            motions.push_back({ { s->stop_centre.x, s->stop_centre.y, s->stop_centre.z }, s->start_time, s->stop_time });
+            m = s->material_ptr;
+        } else {
+            return false;
+        }
+        if (m != last_material) {
+            last_material = m;
+            last_index = material_index(m);
+        }
+        record.centre[0] = centre.x;
+        record.centre[1] = centre.y;
+        record.centre[2] = centre.z;
+        record.material = last_index;
+        spheres.push_back(record);
+    }
+
+    auto aligned = [](uint64_t offset) { return (offset + 63) / 64 * 64; };
+    const std::string& resources = reader.resources();
+    const std::vector<linear_bvh_node>& nodes = bvh.node_array();
+    scene_cache_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "LUMSCN\0\0", 8);
+    header.version = scene_cache_version;
+    header.real_size = uint32_t(sizeof(real));
+    header.key = key;
+    header.resources_offset = aligned(sizeof(header));
+    header.resources_size = resources.size();
+    header.spheres_offset = aligned(header.resources_offset + resources.size());
+    header.sphere_count = spheres.size();
+    header.motions_offset = aligned(header.spheres_offset + spheres.size() * sizeof(cached_sphere));
+    header.motion_count = motions.size();
+    header.nodes_offset = aligned(header.motions_offset + motions.size() * sizeof(cached_sphere_motion));
+    header.node_count = nodes.size();
+    header.file_size = header.nodes_offset + nodes.size() * sizeof(linear_bvh_node);
+    header.material_count = materials.size();
+    aabb bounds = bvh.bounding_box();
+    for (int axis = 0; axis < 3; axis++) {
+        header.bounds[axis] = bounds.axis_interval(axis).min;
+        header.bounds[axis + 3] = bounds.axis_interval(axis).max;
+    }
+
+    // written beside the cache file and renamed over it, so that a reader never sees a partial file
+#ifdef LUMINA_HAS_MMAP
+    std::string temporary = path + ".tmp" + std::to_string(::getpid());
+#else
+    std::string temporary = path + ".tmp";
+#endif
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    uint64_t written = 0;
+    bool ok = true;
+    auto put = [&](uint64_t offset, const void* data, size_t size) {
+        static const char zeros[64] = {};
+        while (ok && written < offset) {
+            size_t gap = size_t(std::min<uint64_t>(offset - written, sizeof(zeros)));
+            ok = std::fwrite(zeros, 1, gap, file) == gap;
+            written += gap;
+        }
+        if (ok && size > 0) ok = std::fwrite(data, 1, size, file) == size;
+        written += size;
+    };
+    put(0, &header, sizeof(header));
+    put(header.resources_offset, resources.data(), resources.size());
+    put(header.spheres_offset, spheres.data(), spheres.size() * sizeof(cached_sphere));
+    put(header.motions_offset, motions.data(), motions.size() * sizeof(cached_sphere_motion));
+    put(header.nodes_offset, nodes.data(), nodes.size() * sizeof(linear_bvh_node));
+    ok = std::fclose(file) == 0 && ok;
+    if (ok) ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+    if (!ok) std::remove(temporary.c_str());
+    return ok;
+}
+
+inline bool make_directory(const std::string& path) {
+#ifdef LUMINA_HAS_MMAP
+    struct stat info;
+    if (::stat(path.c_str(), &info) == 0) return S_ISDIR(info.st_mode);
+    return ::mkdir(path.c_str(), 0777) == 0;
+#else
+    return true;
+#endif
+}
+
+// Loads scene file path into result through the cache in cache_directory: from the cache file if there is
+// a valid one for this scene and these BVH options, otherwise by parsing the scene file, building a
+// linear_bvh with options and writing the cache file. Either way result.objects ends up holding a single
+// BVH (and result.prebuilt_bvh is set). Prints the reason and returns false if the scene file is bad;
+// a cache that cannot be written only warns.
+inline bool load_cached_scene_file(const std::string& path, const std::string& cache_directory,
+                                   const bvh_build_options& options, scene& result) {
+    auto start = std::chrono::steady_clock::now();
+    mapped_file source;
+    if (!source.open(path)) {
+        std::cerr << "Could not open scene file '" << path << "'.\n";
+        return false;
+    }
+    uint64_t key = scene_cache_key(source.data(), source.size(), options);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.lscache", static_cast<unsigned long long>(key));
+    std::string cache_path = cache_directory + "/" + name;
+
+    std::unique_ptr<mapped_file> cache(new mapped_file());
+    if (cache->open(cache_path) && scene_cache_valid(*cache, key)) {
+        const scene_cache_header& header = *reinterpret_cast<const scene_cache_header*>(cache->data());
+        scene_file_header file_header;
+        scene_file_reader reader(path);
+        if (!reader.read(file_header, nullptr)) return false;
+        std::string resources(reinterpret_cast<const char*>(cache->data() + header.resources_offset),
+                              size_t(header.resources_size));
+        if (reader.read_resources(resources, result) && reader.material_definitions().size() == header.material_count) {
+            auto world = make_shared<cached_scene>(std::move(cache), reader.material_definitions());
+            std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - start;
+            std::clog << "Scene cache: loaded " << cache_path << " (" << world->size() << " spheres, "
+                      << world->nodes_in_tree() << " BVH nodes) in " << load_time.count() * 1000 << " ms\n";
+            result.objects = hittable_list(world);
+            result.view = file_header.view;
+            result.prebuilt_bvh = true;
+            return true;
+        }
+        // textures or materials changed meaning (an image went missing, say): start over from the text
+        std::cerr << "Scene cache " << cache_path << " does not match its scene file; rebuilding it.\n";
+        result = scene();
+    }
+
+    scene_file_header file_header;
+    scene_file_reader reader(path);
+    if (!reader.read(file_header, &result)) return false;
+    auto bvh = make_shared<linear_bvh>(result.objects, options);
+    if (!make_directory(cache_directory) || !write_scene_cache(cache_path, key, reader, *bvh)) {
+        std::cerr << "Could not write scene cache " << cache_path << "; rendering without it.\n";
+    } else {
+        std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - start;
+        std::clog << "Scene cache: wrote " << cache_path << " (" << bvh->primitive_array().size() << " objects, "
+                  << bvh->node_count() << " BVH nodes) in " << build_time.count() * 1000 << " ms\n";
+    }
+    result.objects = hittable_list(bvh);
+    result.prebuilt_bvh = true;
+    return true;
+}
+
+#endif //LUMINA_SCENE_CACHE_H
@@ -0,0 +1,489 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_SCENE_FILE_H
+#define LUMINA_SCENE_FILE_H
+
+#include <lumina.h>
+#include <camera.h>
+#include <material.h>
+#include <moving_sphere.h>
+#include <scene.h>
+#include <sphere.h>
+#include <texture.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Text scene description, one statement per line; '#' starts a comment. Names are defined before use.
+//
+//   render KEY VALUE ...          defaults for command-line options (width, spp, min-spp, noise-threshold,
+//                                 integrator, tonemap, tile-size, bvh, accel); the command line wins
+//   camera KEY VALUE ...          lookfrom X Y Z, lookat X Y Z, up X Y Z, vfov DEGREES, aspect W/H,
+//                                 aperture A, focus_distance D, shutter OPEN CLOSE
+//   texture NAME solid R G B
+//   texture NAME checker SCALE R G B R G B
+//   texture NAME checker SCALE EVEN_TEXTURE ODD_TEXTURE
+//   texture NAME image FILE       FILE relative to the scene file, or found like the built-in images
+//   texture NAME noise SCALE
+//   material NAME lambertian R G B
+//   material NAME lambertian TEXTURE
+//   material NAME metal R G B FUZZ
+//   material NAME dielectric ETA
+//   sphere X Y Z RADIUS MATERIAL
+//   moving_sphere X0 Y0 Z0 X1 Y1 Z1 T0 T1 RADIUS MATERIAL
+//
+// render and camera form the header and must come before everything else, so that the settings can be
+// read without parsing the (possibly huge) rest of the file.
+
+// Settings from the header of a scene file.
+struct scene_file_header {
+    // (key, value) pairs of the render statement, in file order
+    std::vector<std::pair<std::string, std::string>> render_options;
+    camera_settings view;
+};
+
+struct scene_token {
+    const char* begin;
+    const char* end;
+
+    size_t size() const { return size_t(end - begin); }
+    bool is(const char* text) const { return size() == std::strlen(text) && std::memcmp(begin, text, size()) == 0; }
+    std::string str() const { return std::string(begin, end); }
+};
+
+// Decimal number in [begin, end). Numbers of at most 19 digits (leading zeros included) with a power of ten
+// within +-22 (which covers coordinates as they are usually written) are converted as mantissa * or / 10^k:
+// both factors are exact doubles, so the one rounding of that operation gives the correctly rounded result,
+// exactly as strtod would. Everything else goes to strtod.
+inline bool parse_scene_number(const char* begin, const char* end, double& value) {
+    static const double powers_of_ten[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* p = begin;
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) p++;
+    // the mantissa may wrap for more than 19 digits, which then go to strtod
+    uint64_t mantissa = 0;
+    const char* first_digit = p;
+    for (; p < end && unsigned(*p - '0') < 10; p++) mantissa = mantissa * 10 + uint64_t(*p - '0');
+    ptrdiff_t digits = p - first_digit;
+    int exponent = 0;
+    if (p < end && *p == '.') {
+        const char* first_fraction = ++p;
+        for (; p < end && unsigned(*p - '0') < 10; p++) mantissa = mantissa * 10 + uint64_t(*p - '0');
+        exponent = -int(std::min<ptrdiff_t>(p - first_fraction, 10000));
+        digits += p - first_fraction;
+    }
+    bool any_digit = digits > 0;
+    if (any_digit && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+')) q++;
+        int written = 0;
+        bool exponent_digit = false;
+        for (; q < end && *q >= '0' && *q <= '9' && written < 10000; q++, exponent_digit = true) {
+            written = written * 10 + (*q - '0');
+        }
+        if (exponent_digit) {
+            exponent += negative_exponent ? -written : written;
+            p = q;
+        }
+    }
+    if (any_digit && p == end && digits <= 19 && mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double magnitude = double(mantissa);
+        magnitude = exponent < 0 ? magnitude / powers_of_ten[-exponent] : magnitude * powers_of_ten[exponent];
+        value = negative ? -magnitude : magnitude;
+        return true;
+    }
+
+    std::string text(begin, end);
+    char* parsed_end;
+    value = std::strtod(text.c_str(), &parsed_end);
+    return !text.empty() && *parsed_end == 0;
+}
+
+// Splits a line into tokens, dropping its comment.
+inline void tokenize_scene_line(const char* line, const char* line_end, std::vector<scene_token>& tokens) {
+    tokens.clear();
+    const char* p = line;
+    while (p < line_end) {
+        while (p < line_end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        if (p == line_end || *p == '#') break;
+        const char* token_start = p;
+        while (p < line_end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '#') p++;
+        tokens.push_back({ token_start, p });
+    }
+}
+
+// Reads a file line by line through a fixed buffer, so memory use does not grow with the file.
+class scene_line_reader {
+public:
+    explicit scene_line_reader(std::FILE* file) : file(file), buffer(1 << 20) {}
+
+    // Splits the next non-empty line (without its comment) into tokens; false at the end of the file.
+    bool next(std::vector<scene_token>& tokens) {
+        while (true) {
+            const char* line = nullptr;
+            const char* line_end = nullptr;
+            if (!next_line(line, line_end)) return false;
+            line_number++;
+            tokenize_scene_line(line, line_end, tokens);
+            if (!tokens.empty()) return true;
+        }
+    }
+
+    int line() const { return line_number; }
+
+private:
+    std::FILE* file;
+    std::vector<char> buffer;
+    // unread data is buffer[begin, end)
+    size_t begin = 0;
+    size_t end = 0;
+    bool at_eof = false;
+    int line_number = 0;
+
+    bool next_line(const char*& line, const char*& line_end) {
+        while (true) {
+            const char* data = buffer.data();
+            const void* newline = begin < end ? std::memchr(data + begin, '\n', end - begin) : nullptr;
+            if (newline || (at_eof && begin < end)) {
+                line = data + begin;
+                line_end = newline ? static_cast<const char*>(newline) : data + end;
+                begin = size_t(line_end - data) + (newline ? 1 : 0);
+                return true;
+            }
+            if (at_eof) return false;
+            // keep the partial line, and make room for at least as much again when it fills the buffer
+            std::memmove(buffer.data(), data + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            if (end == buffer.size()) buffer.resize(2 * buffer.size());
+            size_t read = std::fread(buffer.data() + end, 1, buffer.size() - end, file);
+            end += read;
+            at_eof = read == 0;
+        }
+    }
+};
+
+// Allocates primitives in blocks that the scene keeps in primitive_blocks. The shared_ptrs handed out
+// point into a block without owning it (no control block), so millions of spheres cost a few hundred
+// allocations and no reference counting at all.
+template <typename T>
+class primitive_pool {
+public:
+    template <typename... Args>
+    shared_ptr<hittable> make(scene& result, Args&&... args) {
+        if (!block || block->size() == block->capacity()) {
+            block = make_shared<std::vector<T>>();
+            // blocks grow so that small scenes do not pay for large ones
+            block_size = std::min<size_t>(2 * block_size, 8192);
+            block->reserve(block_size);
+            result.primitive_blocks.push_back(block);
+        }
+        block->emplace_back(std::forward<Args>(args)...);
+        return shared_ptr<hittable>(shared_ptr<hittable>(), &block->back());
+    }
+
+private:
+    shared_ptr<std::vector<T>> block;
+    size_t block_size = 8;
+};
+
+// Parser state for one scene file: named textures and materials, and where errors are reported from.
+class scene_file_reader {
+public:
+    explicit scene_file_reader(const std::string& path) : path(path) {}
+
+    // Reads the header into header and, unless result is null, the rest of the file into result (whose
+    // view is set from the camera statement). Prints the first error and returns false on failure.
+    bool read(scene_file_header& header, scene* result) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            std::cerr << "Could not open scene file '" << path << "'.\n";
+            return false;
+        }
+        scene_line_reader lines(file);
+        bool body = false;
+        bool ok = true;
+        std::vector<scene_token> tokens;
+        while (ok && lines.next(tokens)) {
+            line_number = lines.line();
+            const scene_token& keyword = tokens[0];
+            if (keyword.is("render") || keyword.is("camera")) {
+                if (body) {
+                    ok = fail("'" + keyword.str() + "' must come before all textures, materials and objects");
+                } else {
+                    ok = keyword.is("render") ? read_render(tokens, header) : read_camera(tokens, header.view);
+                }
+                continue;
+            }
+            if (!result) break;
+            body = true;
+            if (keyword.is("sphere")) ok = read_sphere(tokens, *result);
+            else if (keyword.is("moving_sphere")) ok = read_moving_sphere(tokens, *result);
+            else if (keyword.is("material") || keyword.is("texture")) ok = read_resource(tokens, *result);
+            else ok = fail("unknown statement '" + keyword.str() + "'");
+        }
+        std::fclose(file);
+        if (ok && result) result->view = header.view;
+        return ok;
+    }
+
+    // Replays texture and material statements, one per line, as recorded by read() (see resources()).
+    bool read_resources(const std::string& statements, scene& result) {
+        std::vector<scene_token> tokens;
+        const char* p = statements.data();
+        const char* end = p + statements.size();
+        line_number = 0;
+        bool ok = true;
+        while (ok && p < end) {
+            const char* line_end = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+            if (!line_end) line_end = end;
+            line_number++;
+            tokenize_scene_line(p, line_end, tokens);
+            if (!tokens.empty()) ok = read_resource(tokens, result);
+            p = line_end + 1;
+        }
+        return ok;
+    }
+
+    // The texture and material statements read so far, one per line, and the materials in the order they
+    // were defined.
+    const std::string& resources() const { return resource_statements; }
+    const std::vector<const material*>& material_definitions() const { return material_order; }
+
+private:
+    std::string path;
+    int line_number = 0;
+    std::string resource_statements;
+    std::vector<const material*> material_order;
+    std::unordered_map<std::string, const texture*> textures;
+    std::unordered_map<std::string, const material*> materials;
+    primitive_pool<sphere> spheres;
+    primitive_pool<moving_sphere> moving_spheres;
+    // consecutive objects usually share a material, so the last lookup is remembered
+    std::string last_material_name;
+    const material* last_material = nullptr;
+
+    bool fail(const std::string& message) const {
+        std::cerr << path << ":" << line_number << ": " << message << ".\n";
+        return false;
+    }
+
+    bool numbers(const std::vector<scene_token>& tokens, size_t first, size_t count, double* values) const {
+        if (tokens.size() < first + count) return fail("'" + tokens[0].str() + "' needs more values");
+        for (size_t i = 0; i < count; i++) {
+            const scene_token& token = tokens[first + i];
+            if (!parse_scene_number(token.begin, token.end, values[i])) return fail("'" + token.str() + "' is not a number");
+        }
+        return true;
+    }
+
+    bool expect_size(const std::vector<scene_token>& tokens, size_t size) const {
+        if (tokens.size() != size) {
+            return fail("'" + tokens[0].str() + "' takes " + std::to_string(size - 1) + " values, not "
+                        + std::to_string(tokens.size() - 1));
+        }
+        return true;
+    }
+
+    bool read_render(const std::vector<scene_token>& tokens, scene_file_header& header) const {
+        static const char* keys[] = { "width", "spp", "min-spp", "noise-threshold", "integrator", "tonemap",
+                                      "tile-size", "bvh", "accel" };
+        if (tokens.size() % 2 != 1) return fail("'render' takes pairs of option and value");
+        for (size_t i = 1; i < tokens.size(); i += 2) {
+            bool known = false;
+            for (const char* key : keys) known = known || tokens[i].is(key);
+            if (!known) return fail("'" + tokens[i].str() + "' cannot be set from a scene file");
+            header.render_options.emplace_back(tokens[i].str(), tokens[i + 1].str());
+        }
+        return true;
+    }
+
+    bool read_camera(const std::vector<scene_token>& tokens, camera_settings& view) const {
+        size_t i = 1;
+        while (i < tokens.size()) {
+            const scene_token& key = tokens[i++];
+            double v[3];
+            if (key.is("lookfrom") || key.is("lookat") || key.is("up")) {
+                if (!numbers(tokens, i, 3, v)) return false;
+                vec3 value(v[0], v[1], v[2]);
+                if (key.is("lookfrom")) view.lookfrom = value;
+                else if (key.is("lookat")) view.lookat = value;
+                else view.upwards = value;
+                i += 3;
+            } else if (key.is("shutter")) {
+                if (!numbers(tokens, i, 2, v)) return false;
+                view.shutter_time = interval(v[0], v[1]);
+                i += 2;
+            } else if (key.is("vfov") || key.is("aspect") || key.is("aperture") || key.is("focus_distance")) {
+                if (!numbers(tokens, i, 1, v)) return false;
+                if (key.is("vfov")) view.v_fov = v[0];
+                else if (key.is("aspect")) view.aspect_ratio = v[0];
+                else if (key.is("aperture")) view.aperture = v[0];
+                else view.focus_distance = v[0];
+                i += 1;
+            } else {
+                return fail("unknown camera setting '" + key.str() + "'");
+            }
+        }
+        if (!(view.aspect_ratio > 0) || !(view.v_fov > 0 && view.v_fov < 180)) {
+            return fail("the aspect ratio must be positive and the field of view between 0 and 180 degrees");
+        }
+        return true;
+    }
+
+    const texture* find_texture(const scene_token& name) const {
+        auto found = textures.find(name.str());
+        if (found == textures.end()) {
+            fail("unknown texture '" + name.str() + "'");
+            return nullptr;
+        }
+        return found->second;
+    }
+
+    const material* find_material(const scene_token& name) {
+        if (last_material && name.size() == last_material_name.size()
+            && std::memcmp(name.begin, last_material_name.data(), name.size()) == 0) {
+            return last_material;
+        }
+        last_material_name.assign(name.begin, name.end);
+        auto found = materials.find(last_material_name);
+        if (found == materials.end()) {
+            fail("unknown material '" + last_material_name + "'");
+            last_material = nullptr;
+            return nullptr;
+        }
+        last_material = found->second;
+        return last_material;
+    }
+
+    bool define(const std::vector<scene_token>& tokens, size_t min_size) const {
+        if (tokens.size() < min_size) return fail("'" + tokens[0].str() + "' needs a name, a type and values");
+        return true;
+    }
+
+    bool read_resource(const std::vector<scene_token>& tokens, scene& result) {
+        bool ok = tokens[0].is("texture") ? read_texture(tokens, result) : read_material(tokens, result);
+        if (ok) {
+            resource_statements.append(tokens.front().begin, tokens.back().end);
+            resource_statements += '\n';
+        }
+        return ok;
+    }
+
+    bool read_texture(const std::vector<scene_token>& tokens, scene& result) {
+        if (!define(tokens, 4)) return false;
+        const std::string name = tokens[1].str();
+        if (textures.count(name)) return fail("texture '" + name + "' is defined twice");
+        const scene_token& type = tokens[2];
+        double v[7];
+        const texture* made = nullptr;
+        if (type.is("solid")) {
+            if (!expect_size(tokens, 6) || !numbers(tokens, 3, 3, v)) return false;
+            made = result.textures.make<solid_color>(color3(v[0], v[1], v[2]));
+        } else if (type.is("checker")) {
+            if (tokens.size() == 6) {
+                if (!numbers(tokens, 3, 1, v)) return false;
+                const texture* even = find_texture(tokens[4]);
+                const texture* odd = even ? find_texture(tokens[5]) : nullptr;
+                if (!odd) return false;
+                made = result.textures.make<checker_texture>(v[0], even, odd);
+            } else {
+                if (!expect_size(tokens, 10) || !numbers(tokens, 3, 7, v)) return false;
+                made = result.textures.make<checker_texture>(v[0], color3(v[1], v[2], v[3]), color3(v[4], v[5], v[6]));
+            }
+        } else if (type.is("image")) {
+            if (!expect_size(tokens, 4)) return false;
+            made = result.textures.make<image_texture>(image_path(tokens[3].str()).c_str());
+        } else if (type.is("noise")) {
+            if (!expect_size(tokens, 4) || !numbers(tokens, 3, 1, v)) return false;
+            made = result.textures.make<noise_texture>(v[0]);
+        } else {
+            return fail("unknown texture type '" + type.str() + "'");
+        }
+        textures.emplace(name, made);
+        return true;
+    }
+
+    bool read_material(const std::vector<scene_token>& tokens, scene& result) {
+        if (!define(tokens, 4)) return false;
+        const std::string name = tokens[1].str();
+        if (materials.count(name)) return fail("material '" + name + "' is defined twice");
+        const scene_token& type = tokens[2];
+        double v[4];
+        const material* made = nullptr;
+        if (type.is("lambertian")) {
+            if (tokens.size() == 4) {
+                const texture* albedo = find_texture(tokens[3]);
+                if (!albedo) return false;
+                made = result.materials.make<lambertian>(albedo);
+            } else {
+                if (!expect_size(tokens, 6) || !numbers(tokens, 3, 3, v)) return false;
+                made = result.materials.make<lambertian>(color3(v[0], v[1], v[2]));
+            }
+        } else if (type.is("metal")) {
+            if (!expect_size(tokens, 7) || !numbers(tokens, 3, 4, v)) return false;
+            made = result.materials.make<metal>(color3(v[0], v[1], v[2]), v[3]);
+        } else if (type.is("dielectric")) {
+            if (!expect_size(tokens, 4) || !numbers(tokens, 3, 1, v)) return false;
+            made = result.materials.make<dielectric>(v[0]);
+        } else {
+            return fail("unknown material type '" + type.str() + "'");
+        }
+        materials.emplace(name, made);
+        material_order.push_back(made);
+        return true;
+    }
+
+    bool read_sphere(const std::vector<scene_token>& tokens, scene& result) {
+        double v[4];
+        if (!expect_size(tokens, 6) || !numbers(tokens, 1, 4, v)) return false;
+        const material* mat = find_material(tokens[5]);
+        if (!mat) return false;
+        result.objects.add(spheres.make(result, point3(v[0], v[1], v[2]), v[3], mat));
+        return true;
+    }
+
+    bool read_moving_sphere(const std::vector<scene_token>& tokens, scene& result) {
+        double v[9];
+        if (!expect_size(tokens, 11) || !numbers(tokens, 1, 9, v)) return false;
+        const material* mat = find_material(tokens[10]);
+        if (!mat) return false;
+        result.objects.add(
+            moving_spheres.make(result, point3(v[0], v[1], v[2]), point3(v[3], v[4], v[5]), v[6], v[7], v[8], mat));
+        return true;
+    }
+
+    // An image next to the scene file is preferred; otherwise lumina_image searches its usual places.
+    std::string image_path(const std::string& file) const {
+        size_t slash = path.find_last_of("/\\");
+        if (slash == std::string::npos || file.empty() || file[0] == '/') return file;
+        std::string beside = path.substr(0, slash + 1) + file;
+        std::FILE* probe = std::fopen(beside.c_str(), "rb");
+        if (!probe) return file;
+        std::fclose(probe);
+        return beside;
+    }
+};
+
+// Reads only the header (render and camera statements) of a scene file.
+inline bool read_scene_file_header(const std::string& path, scene_file_header& header) {
+    return scene_file_reader(path).read(header, nullptr);
+}
+
+// Reads a whole scene file into result.
+inline bool load_scene_file(const std::string& path, scene& result) {
+    scene_file_header header;
+    return scene_file_reader(path).read(header, &result);
+}
+
+#endif //LUMINA_SCENE_FILE_H
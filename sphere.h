@@ -6,6 +6,7 @@
 #define LUMINA_sphere_H
 
 #include <hittable.h>
+#include <stats.h>
 #include <vec3.h>
 
 using namespace std;
@@ -17,18 +18,26 @@ public:
     // Data items
     point3 centre;
     double radius;
-    shared_ptr<material> material_ptr;
+    const material* material_ptr;
     aabb bbox;
     // Function definitions
     sphere() {}
-    sphere(point3 centre, double radius, shared_ptr<material> m) : centre(centre), radius(radius), material_ptr(m)   {
+    sphere(point3 centre, double radius, const material* m) : centre(centre), radius(radius), material_ptr(m)   {
         vec3 extrema(radius, radius, radius);
         bbox = aabb(centre - extrema, centre + extrema);
     }
     virtual bool hit(const ray& r, interval t_interval, hit_record& hit_rec) const override;
+    virtual void finalize(const ray& r, hit_record& hit_rec) const override;
     aabb bounding_box() const override { return bbox; };
 
-    static void get_sphere_uv(const point3& p, double& u, double& v) {
+    static void get_sphere_uv(const point3& p, real& u, real& v) {
+        if (fast_math_mode()) {
+            // fast_acos needs |y| <= 1, which rounding of a unit normal can break by an ulp
+            real y = -p.y < -1 ? -1 : (-p.y > 1 ? 1 : -p.y);
+            u = (fast_atan2(-p.z, p.x) + real(pi)) / real(2 * pi);
+            v = fast_acos(y) / real(pi);
+            return;
+        }
         auto theta = std::acos(-p.y);
         auto phi = std::atan2(-p.z, p.x) + pi;
 
@@ -37,26 +46,64 @@ public:
     }
 };
 
-bool sphere::hit(const ray &r, interval t_interval, hit_record &hit_rec) const {
-    vec3 ray_to_circle_centre = r.origin - centre;
-    auto a = dot(r.direction, r.direction);
-    auto half_b = dot(ray_to_circle_centre, r.direction);
-    auto c = ray_to_circle_centre.length_squared() - radius*radius;
-    auto discriminant = half_b*half_b - a*c;
-    if (discriminant < 0) return false; // No intersection
-    auto root = (-half_b - sqrt(discriminant)) / a;
+// Ray parameter of the first intersection of r with the sphere (centre, radius) inside t_interval. Shared
+// by every sphere representation (sphere, moving_sphere, sphere_set and the scene cache) so that they all
+// produce exactly the same hits. The roots are t_mid -+ h around the parameter t_mid of the ray's closest
+// approach to the centre; computing h from the closest-approach vector l rather than from b^2 - 4ac keeps
+// it accurate for small spheres far from the ray origin.
+inline bool sphere_root(const point3& centre, double radius, const ray& r, const interval& t_interval, real& hit_root) {
+    vec3 f = r.origin - centre;
+    double inverse_a = 1 / r.direction.length_squared();
+    double t_mid = -dot(f, r.direction) * inverse_a;
+    vec3 l = f + t_mid * r.direction;
+    double h_sq = (radius * radius - l.length_squared()) * inverse_a;
+    if (h_sq < 0) return false; // No intersection
+    double h = std::sqrt(h_sq);
+    double root = t_mid - h;
     if (root < t_interval.min || t_interval.max < root)   {
-        root = (-half_b + sqrt(discriminant) / a);
+        root = t_mid + h;
         if (root < t_interval.min || t_interval.max < root) return false; // No intersection
     }
-    hit_rec.root = root;
-    hit_rec.point = r.at(root);
+    hit_root = real(root);
+    return true;
+}
+
+// Ray cone at a hit on a sphere (see ray.h), once the normal is set. Hollow spheres have a negative radius
+// and normals that point inwards, which the sign of the curvature takes care of.
+inline void set_sphere_cone(const ray& r, double radius, hit_record& hit_rec) {
+    if (!r.has_cone()) {
+        hit_rec.cone_width = 0;
+        hit_rec.curvature = 0;
+        hit_rec.footprint = texture_footprint();
+        return;
+    }
+    hit_rec.curvature = real((hit_rec.front_face ? 1 : -1) / radius);
+    hit_rec.cone_width = r.cone_width_at(hit_rec.root);
+    // the footprint stretches along the surface as the ray meets it more obliquely, up to a limit
+    real cosine = std::fabs(dot(unit(r.direction), hit_rec.normal));
+    real world = std::fabs(hit_rec.cone_width) / std::fmax(cosine, real(0.125));
+    hit_rec.footprint.world = world;
+    // get_sphere_uv spreads a full circle over u and half a circle over v
+    hit_rec.footprint.u = world / real(2 * pi * std::fabs(radius));
+    hit_rec.footprint.v = world / real(pi * std::fabs(radius));
+}
+
+bool sphere::hit(const ray &r, interval t_interval, hit_record &hit_rec) const {
+    LUMINA_COUNT(primitive_tests);
+    if (!sphere_root(centre, radius, r, t_interval, hit_rec.root)) return false;
+    hit_rec.object = this;
+    hit_rec.primitive_id = 0;
+    return true;
+}
+
+void sphere::finalize(const ray &r, hit_record &hit_rec) const {
+    hit_rec.point = r.at(hit_rec.root);
     vec3 outward_normal = (hit_rec.point - centre) / radius;
     hit_rec.set_face_normal(r, outward_normal);
+    set_sphere_cone(r, radius, hit_rec);
     // set the u-v coordinates
     get_sphere_uv(outward_normal, hit_rec.u, hit_rec.v);
     hit_rec.material_ptr = material_ptr;
-    return true;
 }
 
 #endif //LUMINA_sphere_H
@@ -0,0 +1,412 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_SPHERE_SET_H
+#define LUMINA_SPHERE_SET_H
+
+#include <lumina.h>
+#include <aabb.h>
+#include <bvh.h>
+#include <hittable.h>
+#include <linear_bvh.h>
+#include <sphere.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Many spheres in one hittable, for particle scenes with millions of them. A sphere object costs a vtable
+// pointer, a material pointer, a cached aabb and a shared_ptr in the scene list, plus a node in the
+// scene BVH; here a sphere is four Reals (centre and radius) and a material index, stored
+// structure-of-arrays style. The set has its own flattened BVH whose leaves hold up to 8 consecutive
+// spheres, and a leaf is tested in packets of 4 with SSE or, when the compiler targets AVX and the leaf
+// has more than 4 spheres, all 8 lanes in one AVX pass. Real = float halves the storage; the
+// float test only picks candidate spheres, and every candidate is then intersected in double precision.
+template <typename Real>
+class sphere_set : public hittable {
+public:
+    static const int packet_width = 4;
+
+    void reserve(size_t count) {
+        centre_x.reserve(count);
+        centre_y.reserve(count);
+        centre_z.reserve(count);
+        radius.reserve(count);
+        material_id.reserve(count);
+    }
+
+    void add(const point3& centre, double sphere_radius, const material* m) {
+        auto found = material_index.find(m);
+        uint32_t id;
+        if (found == material_index.end()) {
+            id = uint32_t(materials.size());
+            materials.push_back(m);
+            material_index.emplace(m, id);
+        } else {
+            id = found->second;
+        }
+        centre_x.push_back(Real(centre.x));
+        centre_y.push_back(Real(centre.y));
+        centre_z.push_back(Real(centre.z));
+        radius.push_back(Real(sphere_radius));
+        material_id.push_back(id);
+    }
+
+    size_t size() const { return sphere_count; }
+
+    // Build the BVH over all spheres added so far. The sphere arrays are reordered into leaf order, so
+    // add() must not be called afterwards.
+    void build(bvh_build_options options = bvh_build_options()) {
+        options.method = bvh_build_method::sah;
+        options.max_leaf_size = 2 * packet_width;
+        // a packet of spheres costs about as much as one box test
+        options.intersection_cost = options.traversal_cost / packet_width;
+
+        sphere_count = centre_x.size();
+        std::vector<build_item> items(sphere_count);
+        for (size_t i = 0; i < sphere_count; i++) {
+            items[i].bbox = sphere_bounds(i);
+            items[i].index = uint32_t(i);
+        }
+        bbox = aabb::empty;
+        nodes.clear();
+        if (items.empty()) return;
+
+        std::vector<uint32_t> slot_order;
+        slot_order.reserve(sphere_count + 2 * packet_width);
+        build_node(items, 0, items.size(), options, slot_order);
+        nodes.shrink_to_fit();
+        // a packet load at the last leaf may read up to 2 * packet_width - 1 slots past the last sphere
+        slot_order.resize(sphere_count + 2 * packet_width - 1, uint32_t(padding_slot));
+        bbox = aabb(point3(nodes[0].bounds_min[0], nodes[0].bounds_min[1], nodes[0].bounds_min[2]),
+                    point3(nodes[0].bounds_max[0], nodes[0].bounds_max[1], nodes[0].bounds_max[2]));
+
+        // permute into leaf order; padding slots get a NaN centre so that they can never become candidates
+        const Real nan = std::numeric_limits<Real>::quiet_NaN();
+        std::vector<Real> x(slot_order.size()), y(slot_order.size()), z(slot_order.size()), rad(slot_order.size());
+        std::vector<uint32_t> ids(slot_order.size());
+        for (size_t slot = 0; slot < slot_order.size(); slot++) {
+            uint32_t i = slot_order[slot];
+            bool padding = i == padding_slot;
+            x[slot] = padding ? nan : centre_x[i];
+            y[slot] = padding ? nan : centre_y[i];
+            z[slot] = padding ? nan : centre_z[i];
+            rad[slot] = padding ? Real(0) : radius[i];
+            ids[slot] = padding ? 0 : material_id[i];
+        }
+        centre_x.swap(x);
+        centre_y.swap(y);
+        centre_z.swap(z);
+        radius.swap(rad);
+        material_id.swap(ids);
+        std::unordered_map<const material*, uint32_t>().swap(material_index);
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (nodes.empty()) return false;
+
+        float origin[3] = { float(r.origin.x), float(r.origin.y), float(r.origin.z) };
+        float inverse_direction[3] = { float(1.0 / r.direction.x), float(1.0 / r.direction.y), float(1.0 / r.direction.z) };
+        bool direction_is_negative[3] = { inverse_direction[0] < 0, inverse_direction[1] < 0, inverse_direction[2] < 0 };
+        packet_ray pr = make_packet_ray(r);
+
+        bool hit_anything = false;
+        uint32_t stack[linear_bvh_max_depth];
+        int stack_size = 0;
+        uint32_t node_index = 0;
+
+        while (true) {
+            LUMINA_COUNT(bvh_nodes_visited);
+            LUMINA_COUNT(aabb_tests);
+            const linear_bvh_node& node = nodes[node_index];
+            if (linear_bvh_box_hit(node, origin, inverse_direction, ray_t)) {
+                if (node.primitive_count > 0) {
+                    LUMINA_COUNT_N(primitive_tests, node.primitive_count);
+                    int candidates = leaf_candidates(node.offset, node.primitive_count, pr, Real(ray_t.min),
+                                                     Real(ray_t.max));
+                    for (int lane = 0; candidates != 0; lane++, candidates >>= 1) {
+                        if ((candidates & 1) && hit_sphere(node.offset + lane, r, ray_t, rec)) {
+                            hit_anything = true;
+                            ray_t.max = rec.root;
+                        }
+                    }
+                    if (stack_size == 0) break;
+                    node_index = stack[--stack_size];
+                } else if (direction_is_negative[node.axis]) {
+                    stack[stack_size++] = node_index + 1;
+                    node_index = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    node_index = node_index + 1;
+                }
+            } else {
+                if (stack_size == 0) break;
+                node_index = stack[--stack_size];
+            }
+        }
+        return hit_anything;
+    }
+
+    void finalize(const ray& r, hit_record& rec) const override {
+        uint32_t slot = rec.primitive_id;
+        point3 centre(centre_x[slot], centre_y[slot], centre_z[slot]);
+        rec.point = r.at(rec.root);
+        vec3 outward_normal = (rec.point - centre) / double(radius[slot]);
+        rec.set_face_normal(r, outward_normal);
+        set_sphere_cone(r, double(radius[slot]), rec);
+        sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.material_ptr = materials[material_id[slot]];
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    // Memory held by the set: sphere slots, BVH nodes and the material table.
+    size_t memory_bytes() const {
+        return centre_x.capacity() * sizeof(Real) * 4 + material_id.capacity() * sizeof(uint32_t)
+               + nodes.capacity() * sizeof(linear_bvh_node) + materials.capacity() * sizeof(const material*);
+    }
+
+    double bytes_per_sphere() const { return sphere_count > 0 ? double(memory_bytes()) / double(sphere_count) : 0.0; }
+
+    // Lower bound on the cost of one sphere object in a scene list: the object and the list's shared_ptr,
+    // before counting its shared_ptr control block or any BVH over it.
+    static size_t sphere_object_bytes() { return sizeof(sphere) + sizeof(shared_ptr<hittable>); }
+
+private:
+    struct build_item {
+        aabb bbox;
+        uint32_t index;
+    };
+
+    // ray constants of the packet test, already converted to Real
+    struct packet_ray {
+        Real origin[3];
+        Real direction[3];
+        Real inverse_length_sq;
+        // widening of the radius that covers rounding of the centre and origin coordinates
+        Real position_tolerance;
+    };
+
+    static const uint32_t padding_slot = std::numeric_limits<uint32_t>::max();
+
+    std::vector<Real> centre_x, centre_y, centre_z, radius;
+    std::vector<uint32_t> material_id;
+    std::vector<const material*> materials;
+    std::unordered_map<const material*, uint32_t> material_index;
+    std::vector<linear_bvh_node> nodes;
+    size_t sphere_count = 0;
+    aabb bbox;
+
+    aabb sphere_bounds(size_t i) const {
+        vec3 extent(std::fabs(double(radius[i])), std::fabs(double(radius[i])), std::fabs(double(radius[i])));
+        point3 centre(centre_x[i], centre_y[i], centre_z[i]);
+        return aabb(centre - extent, centre + extent);
+    }
+
+    uint32_t build_node(std::vector<build_item>& items, size_t start, size_t end, const bvh_build_options& options,
+                        std::vector<uint32_t>& slot_order) {
+        aabb bounds = aabb::empty;
+        for (size_t i = start; i < end; i++) bounds = aabb(bounds, items[i].bbox);
+
+        uint32_t node_index = uint32_t(nodes.size());
+        nodes.emplace_back();
+        linear_bvh_store_bounds(nodes[node_index], bounds);
+
+        size_t span = end - start;
+        size_t mid = end;
+        if (span > 1) {
+            if (linear_bvh_needs_median_split(options.depth, span)) {
+                mid = linear_bvh_median_split(items, start, end, bounds);
+            } else {
+                mid = bvh_sah_partition(items, start, end, bounds, [](const build_item& item) { return item.bbox; },
+                                        options);
+            }
+        }
+
+        if (mid == end) {
+            linear_bvh_node& leaf = nodes[node_index];
+            leaf.offset = uint32_t(slot_order.size());
+            leaf.primitive_count = uint16_t(span);
+            leaf.axis = 0;
+            for (size_t i = start; i < end; i++) slot_order.push_back(items[i].index);
+            return node_index;
+        }
+
+        // as in linear_bvh: the first child is the one on the negative side of the split axis
+        aabb lower = aabb::empty, upper = aabb::empty;
+        for (size_t i = start; i < mid; i++) lower = aabb(lower, items[i].bbox);
+        for (size_t i = mid; i < end; i++) upper = aabb(upper, items[i].bbox);
+        vec3 gap = upper.centroid() - lower.centroid();
+        double ax = std::fabs(gap.x), ay = std::fabs(gap.y), az = std::fabs(gap.z);
+        int axis = (ax >= ay && ax >= az) ? 0 : (ay >= az ? 1 : 2);
+        bvh_build_options child_options = options.child_options();
+        uint32_t second_child;
+        if (gap[axis] < 0) {
+            build_node(items, mid, end, child_options, slot_order);
+            second_child = build_node(items, start, mid, child_options, slot_order);
+        } else {
+            build_node(items, start, mid, child_options, slot_order);
+            second_child = build_node(items, mid, end, child_options, slot_order);
+        }
+        linear_bvh_node& node = nodes[node_index];
+        node.offset = second_child;
+        node.primitive_count = 0;
+        node.axis = uint8_t(axis);
+        return node_index;
+    }
+
+    static packet_ray make_packet_ray(const ray& r) {
+        packet_ray pr;
+        pr.origin[0] = Real(r.origin.x);
+        pr.origin[1] = Real(r.origin.y);
+        pr.origin[2] = Real(r.origin.z);
+        pr.direction[0] = Real(r.direction.x);
+        pr.direction[1] = Real(r.direction.y);
+        pr.direction[2] = Real(r.direction.z);
+        pr.inverse_length_sq = Real(1.0 / r.direction.length_squared());
+        double origin_scale = std::fabs(r.origin.x) + std::fabs(r.origin.y) + std::fabs(r.origin.z);
+        pr.position_tolerance = Real(8.0 * std::numeric_limits<Real>::epsilon() * origin_scale);
+        return pr;
+    }
+
+    // Bit mask of the slots [first_slot, first_slot + count) whose sphere the ray may hit within
+    // [t_min, t_max]. The test is deliberately a little generous; hit_sphere() has the final say.
+    int leaf_candidates(uint32_t first_slot, int count, const packet_ray& pr, Real t_min, Real t_max) const {
+        return sphere_set_candidates_scalar(*this, first_slot, count, pr, t_min, t_max);
+    }
+
+    // Candidate test of `count` slots, one at a time. Written with the same operation order as the SIMD
+    // versions, so that all of them accept the same spheres.
+    friend int sphere_set_candidates_scalar(const sphere_set& set, uint32_t first_slot, int count,
+                                            const packet_ray& pr, Real t_min, Real t_max) {
+        const Real eps = 8 * std::numeric_limits<Real>::epsilon();
+        int mask = 0;
+        for (int lane = 0; lane < count; lane++) {
+            uint32_t slot = first_slot + lane;
+            // f = origin - centre; the closest approach to the centre is at t_mid, at distance |l|
+            Real fx = pr.origin[0] - set.centre_x[slot];
+            Real fy = pr.origin[1] - set.centre_y[slot];
+            Real fz = pr.origin[2] - set.centre_z[slot];
+            Real b = fx * pr.direction[0] + fy * pr.direction[1] + fz * pr.direction[2];
+            Real t_mid = -b * pr.inverse_length_sq;
+            Real lx = fx + t_mid * pr.direction[0];
+            Real ly = fy + t_mid * pr.direction[1];
+            Real lz = fz + t_mid * pr.direction[2];
+            Real tolerance = pr.position_tolerance + eps * (std::fabs(fx) + std::fabs(fy) + std::fabs(fz));
+            Real r = std::fabs(set.radius[slot]) + tolerance;
+            Real h_sq = (r * r - (lx * lx + ly * ly + lz * lz)) * pr.inverse_length_sq;
+            if (!(h_sq >= 0)) continue;
+            Real h = std::sqrt(h_sq);
+            Real slack = eps * (std::fabs(t_mid) + h);
+            if (t_mid + h + slack >= t_min && t_mid - h - slack <= t_max) mask |= 1 << lane;
+        }
+        return mask;
+    }
+
+    // Exact intersection with the sphere in `slot`, the same as that of a sphere object.
+    bool hit_sphere(uint32_t slot, const ray& r, const interval& ray_t, hit_record& rec) const {
+        point3 centre(centre_x[slot], centre_y[slot], centre_z[slot]);
+        if (!sphere_root(centre, double(radius[slot]), r, ray_t, rec.root)) return false;
+        rec.object = this;
+        rec.primitive_id = slot;
+        return true;
+    }
+};
+
+#if defined(__SSE2__) || defined(_M_X64)
+// SSE test of one packet of 4 float spheres; same steps as sphere_set_candidates_scalar.
+inline int sphere_set_candidates_sse(const float* cx, const float* cy, const float* cz, const float* cr,
+                                     const float* origin, const float* direction, float inverse_length_sq,
+                                     float position_tolerance, float t_min, float t_max) {
+    const __m128 eps = _mm_set1_ps(8 * std::numeric_limits<float>::epsilon());
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 dx = _mm_set1_ps(direction[0]), dy = _mm_set1_ps(direction[1]), dz = _mm_set1_ps(direction[2]);
+    __m128 inv_a = _mm_set1_ps(inverse_length_sq);
+    __m128 fx = _mm_sub_ps(_mm_set1_ps(origin[0]), _mm_loadu_ps(cx));
+    __m128 fy = _mm_sub_ps(_mm_set1_ps(origin[1]), _mm_loadu_ps(cy));
+    __m128 fz = _mm_sub_ps(_mm_set1_ps(origin[2]), _mm_loadu_ps(cz));
+    __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(fx, dx), _mm_mul_ps(fy, dy)), _mm_mul_ps(fz, dz));
+    __m128 t_mid = _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), b), inv_a);
+    __m128 lx = _mm_add_ps(fx, _mm_mul_ps(t_mid, dx));
+    __m128 ly = _mm_add_ps(fy, _mm_mul_ps(t_mid, dy));
+    __m128 lz = _mm_add_ps(fz, _mm_mul_ps(t_mid, dz));
+    __m128 f_scale = _mm_add_ps(_mm_add_ps(_mm_and_ps(fx, abs_mask), _mm_and_ps(fy, abs_mask)), _mm_and_ps(fz, abs_mask));
+    __m128 tolerance = _mm_add_ps(_mm_set1_ps(position_tolerance), _mm_mul_ps(eps, f_scale));
+    __m128 r = _mm_add_ps(_mm_and_ps(_mm_loadu_ps(cr), abs_mask), tolerance);
+    __m128 l_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+    __m128 h_sq = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(r, r), l_sq), inv_a);
+    __m128 valid = _mm_cmpge_ps(h_sq, _mm_setzero_ps());
+    __m128 h = _mm_sqrt_ps(_mm_max_ps(h_sq, _mm_setzero_ps()));
+    __m128 slack = _mm_mul_ps(eps, _mm_add_ps(_mm_and_ps(t_mid, abs_mask), h));
+    __m128 reach = _mm_add_ps(h, slack);
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(_mm_add_ps(t_mid, reach), _mm_set1_ps(t_min)));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_sub_ps(t_mid, reach), _mm_set1_ps(t_max)));
+    return _mm_movemask_ps(valid);
+}
+
+#if defined(__AVX__)
+// AVX test of two packets (8 float spheres) at once.
+inline int sphere_set_candidates_avx(const float* cx, const float* cy, const float* cz, const float* cr,
+                                     const float* origin, const float* direction, float inverse_length_sq,
+                                     float position_tolerance, float t_min, float t_max) {
+    const __m256 eps = _mm256_set1_ps(8 * std::numeric_limits<float>::epsilon());
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 dx = _mm256_set1_ps(direction[0]), dy = _mm256_set1_ps(direction[1]), dz = _mm256_set1_ps(direction[2]);
+    __m256 inv_a = _mm256_set1_ps(inverse_length_sq);
+    __m256 fx = _mm256_sub_ps(_mm256_set1_ps(origin[0]), _mm256_loadu_ps(cx));
+    __m256 fy = _mm256_sub_ps(_mm256_set1_ps(origin[1]), _mm256_loadu_ps(cy));
+    __m256 fz = _mm256_sub_ps(_mm256_set1_ps(origin[2]), _mm256_loadu_ps(cz));
+    __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(fx, dx), _mm256_mul_ps(fy, dy)), _mm256_mul_ps(fz, dz));
+    __m256 t_mid = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), b), inv_a);
+    __m256 lx = _mm256_add_ps(fx, _mm256_mul_ps(t_mid, dx));
+    __m256 ly = _mm256_add_ps(fy, _mm256_mul_ps(t_mid, dy));
+    __m256 lz = _mm256_add_ps(fz, _mm256_mul_ps(t_mid, dz));
+    __m256 f_scale = _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(fx, abs_mask), _mm256_and_ps(fy, abs_mask)),
+                                   _mm256_and_ps(fz, abs_mask));
+    __m256 tolerance = _mm256_add_ps(_mm256_set1_ps(position_tolerance), _mm256_mul_ps(eps, f_scale));
+    __m256 r = _mm256_add_ps(_mm256_and_ps(_mm256_loadu_ps(cr), abs_mask), tolerance);
+    __m256 l_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz));
+    __m256 h_sq = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(r, r), l_sq), inv_a);
+    __m256 valid = _mm256_cmp_ps(h_sq, _mm256_setzero_ps(), _CMP_GE_OQ);
+    __m256 h = _mm256_sqrt_ps(_mm256_max_ps(h_sq, _mm256_setzero_ps()));
+    __m256 slack = _mm256_mul_ps(eps, _mm256_add_ps(_mm256_and_ps(t_mid, abs_mask), h));
+    __m256 reach = _mm256_add_ps(h, slack);
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(t_mid, reach), _mm256_set1_ps(t_min), _CMP_GE_OQ));
+    valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_sub_ps(t_mid, reach), _mm256_set1_ps(t_max), _CMP_LE_OQ));
+    return _mm256_movemask_ps(valid);
+}
+#endif
+
+template <>
+inline int sphere_set<float>::leaf_candidates(uint32_t first_slot, int count, const packet_ray& pr, float t_min,
+                                              float t_max) const {
+    // lanes past `count` belong to the next leaf (or the padding at the end) and are masked off
+    const int lanes = (1 << count) - 1;
+#if defined(__AVX__)
+    if (count > packet_width) {
+        return sphere_set_candidates_avx(&centre_x[first_slot], &centre_y[first_slot], &centre_z[first_slot],
+                                         &radius[first_slot], pr.origin, pr.direction, pr.inverse_length_sq,
+                                         pr.position_tolerance, t_min, t_max) & lanes;
+    }
+#endif
+    int mask = 0;
+    for (int packet = 0; packet * packet_width < count; packet++) {
+        uint32_t slot = first_slot + packet * packet_width;
+        mask |= sphere_set_candidates_sse(&centre_x[slot], &centre_y[slot], &centre_z[slot], &radius[slot],
+                                          pr.origin, pr.direction, pr.inverse_length_sq, pr.position_tolerance,
+                                          t_min, t_max) << (packet * packet_width);
+    }
+    return mask & lanes;
+}
+#endif
+
+#endif //LUMINA_SPHERE_SET_H
@@ -0,0 +1,127 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_STATS_H
+#define LUMINA_STATS_H
+
+#include <cstdint>
+#include <mutex>
+
+// Optional traversal counters. They are only compiled in when LUMINA_STATS is defined (see the
+// LUMINA_STATS option in CMakeLists.txt); otherwise LUMINA_COUNT() expands to nothing and the hot
+// loops carry no instrumentation at all.
+
+// Upper bound on material_type::count, so that the counters need not depend on material.h.
+const int stats_material_types = 4;
+// Path length histogram: bin n counts paths of n rays, the last bin those of path_length_bins - 1 or more.
+const int path_length_bins = 33;
+
+inline int path_length_bin(uint64_t length) {
+    return length < uint64_t(path_length_bins - 1) ? int(length) : path_length_bins - 1;
+}
+
+// The counters that are also kept per pixel (see framebuffer::cost).
+struct pixel_cost {
+    uint64_t rays = 0;
+    uint64_t bvh_nodes_visited = 0;
+    uint64_t aabb_tests = 0;
+    uint64_t primitive_tests = 0;
+
+    pixel_cost& operator+=(const pixel_cost& other) {
+        rays += other.rays;
+        bvh_nodes_visited += other.bvh_nodes_visited;
+        aabb_tests += other.aabb_tests;
+        primitive_tests += other.primitive_tests;
+        return *this;
+    }
+
+    pixel_cost operator-(const pixel_cost& other) const {
+        pixel_cost result;
+        result.rays = rays - other.rays;
+        result.bvh_nodes_visited = bvh_nodes_visited - other.bvh_nodes_visited;
+        result.aabb_tests = aabb_tests - other.aabb_tests;
+        result.primitive_tests = primitive_tests - other.primitive_tests;
+        return result;
+    }
+
+    // bounding box tests plus primitive intersection tests, the work a ray costs in traversal
+    uint64_t traversal_cost() const { return aabb_tests + primitive_tests; }
+};
+
+struct traversal_stats {
+    uint64_t rays = 0;
+    uint64_t bvh_nodes_visited = 0;
+    // ray-box slab tests; a wide BVH node tests all of its children at once and counts each of them
+    uint64_t aabb_tests = 0;
+    // ray-primitive tests, including those done four or eight at a time by sphere_set
+    uint64_t primitive_tests = 0;
+    // material::scatter() calls, indexed by material_type
+    uint64_t scatter_calls[stats_material_types] = {};
+    // number of rays in each camera path (see path_length_bin)
+    uint64_t path_lengths[path_length_bins] = {};
+
+    void merge(const traversal_stats& other) {
+        rays += other.rays;
+        bvh_nodes_visited += other.bvh_nodes_visited;
+        aabb_tests += other.aabb_tests;
+        primitive_tests += other.primitive_tests;
+        for (int i = 0; i < stats_material_types; i++) scatter_calls[i] += other.scatter_calls[i];
+        for (int i = 0; i < path_length_bins; i++) path_lengths[i] += other.path_lengths[i];
+    }
+
+    pixel_cost cost() const {
+        pixel_cost result;
+        result.rays = rays;
+        result.bvh_nodes_visited = bvh_nodes_visited;
+        result.aabb_tests = aabb_tests;
+        result.primitive_tests = primitive_tests;
+        return result;
+    }
+};
+
+#ifdef LUMINA_STATS
+const bool stats_enabled = true;
+#define LUMINA_COUNT(counter) (thread_traversal_stats().counter++)
+#define LUMINA_COUNT_N(counter, n) (thread_traversal_stats().counter += (n))
+#else
+const bool stats_enabled = false;
+#define LUMINA_COUNT(counter) ((void)0)
+#define LUMINA_COUNT_N(counter, n) ((void)0)
+#endif
+
+inline traversal_stats& thread_traversal_stats() {
+    thread_local traversal_stats stats;
+    return stats;
+}
+
+// Totals of all threads. Render threads hand over their counters with flush_thread_stats() at the end of
+// every tile, so the global lock is only taken once per tile.
+class global_stats {
+public:
+    static void flush_thread_stats() {
+        if (!stats_enabled) return;
+        traversal_stats& local = thread_traversal_stats();
+        std::lock_guard<std::mutex> lock(mutex());
+        totals().merge(local);
+        local = traversal_stats();
+    }
+
+    static traversal_stats snapshot() {
+        std::lock_guard<std::mutex> lock(mutex());
+        return totals();
+    }
+
+private:
+    static std::mutex& mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    static traversal_stats& totals() {
+        static traversal_stats t;
+        return t;
+    }
+};
+
+#endif //LUMINA_STATS_H
@@ -6,13 +6,21 @@
 #define LUMINA_TEXTURE_H
 
 #include <color.h>
-#include <lumina_stb_image.h>
 #include <perlin.h>
+#include <ray.h>
+#include <texture_cache.h>
+
+#include <algorithm>
+#include <cmath>
+
+enum class texture_type { none, solid, checker, image, noise, count };
 
 class texture {
 public:
     virtual ~texture() = default;
-    virtual color3 value(double u, double v, const point3& p) const = 0;
+    // Colour at texture coordinates (u, v) and point p, averaged over footprint where the texture can.
+    virtual color3 value(double u, double v, const point3& p, const texture_footprint& footprint) const = 0;
+    virtual texture_type type() const = 0;
 };
 
 class solid_color : public texture {
@@ -21,62 +29,98 @@ public:
 
     solid_color(double red, double green, double blue) : solid_color(color3(red, green, blue)) {}
 
-    color3 value(double u, double v, const point3& p) const override {
+    color3 value(double u, double v, const point3& p, const texture_footprint& footprint) const override {
         return albedo;
     }
+
+    texture_type type() const override { return texture_type::solid; }
 private:
     color3 albedo;
 };
 
 class checker_texture : public texture {
 public:
-    checker_texture(double scale, shared_ptr<texture> even, shared_ptr<texture> odd) : inv_scale(1.0/scale), even(even), odd(odd) {}
+    checker_texture(double scale, const texture* even, const texture* odd)
+        : inv_scale(1.0/scale), even_color(0, 0, 0), odd_color(0, 0, 0), even(even), odd(odd) {}
 
-    checker_texture(double scale, const color3& c1, const color3& c2) : checker_texture(scale, make_shared<solid_color>(c1), make_shared<solid_color>(c2)) {}
+    // plain colours are kept inside the texture rather than in the scene's texture table
+    checker_texture(double scale, const color3& c1, const color3& c2)
+        : inv_scale(1.0/scale), even_color(c1), odd_color(c2), even(&even_color), odd(&odd_color) {}
 
-    color3 value(double u, double v, const point3& p) const override {
+    // even and odd may point at our own colours
+    checker_texture(const checker_texture&) = delete;
+    checker_texture& operator=(const checker_texture&) = delete;
+
+    color3 value(double u, double v, const point3& p, const texture_footprint& footprint) const override {
         auto xInteger = int(std::floor(inv_scale * p.x));
         auto yInteger = int(std::floor(inv_scale * p.y));
         auto zInteger = int(std::floor(inv_scale * p.z));
 
         bool isEven = (xInteger + yInteger + zInteger) % 2 == 0;
 
-        return isEven ? even -> value(u, v, p) : odd -> value(u, v, p);
+        return isEven ? even -> value(u, v, p, footprint) : odd -> value(u, v, p, footprint);
     }
+
+    texture_type type() const override { return texture_type::checker; }
 private:
     double inv_scale;
-    shared_ptr<texture> even;
-    shared_ptr<texture> odd;
+    solid_color even_color;
+    solid_color odd_color;
+    const texture* even;
+    const texture* odd;
 };
 
 class image_texture : public texture {
 public:
-    image_texture(const char* filename) : image(filename) {}
+    // images are shared with every other texture of the same file (see texture_cache)
+    image_texture(const char* filename) : image(shared_texture_cache().open(filename)) {}
 
-    color3 value(double u, double v, const point3& p) const override {
-        if (image.height() <= 0) return color3(0, 1, 1);
+    color3 value(double u, double v, const point3& p, const texture_footprint& footprint) const override {
+        if (image < 0) return color3(0, 1, 1);
+        texture_cache& cache = shared_texture_cache();
 
         u = interval(0, 1).clamp(u);
         v = 1.0 - interval(0, 1).clamp(v);
 
-        auto i = int(u * image.width());
-        auto j = int(v * image.height());
-        auto pixel = image.pixel_data(i, j);
+        // mip level whose texels are as wide as the footprint, blending the two nearest levels
+        double texels = std::max(footprint.u * cache.width(image), footprint.v * cache.height(image));
+        if (texels <= 1) return level_value(cache, 0, u, v);
+        double level = std::min(std::log2(texels), double(cache.levels(image) - 1));
+        int lower = int(level);
+        double blend = level - lower;
+        color3 result = level_value(cache, lower, u, v);
+        if (blend > 0) result = (1 - blend) * result + blend * level_value(cache, lower + 1, u, v);
+        return result;
+    }
+
+    texture_type type() const override { return texture_type::image; }
+private:
+    // id in shared_texture_cache(), or -1 if the file could not be loaded
+    int image;
+
+    // nearest texel of a mip level
+    color3 level_value(texture_cache& cache, int level, double u, double v) const {
+        auto i = int(u * cache.width(image, level));
+        auto j = int(v * cache.height(image, level));
+        unsigned char pixel[3];
+        cache.texel(image, level, i, j, pixel);
 
         auto color_scale = 1.0 / 255.0;
         return color3(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
     }
-private:
-    lumina_image image;
 };
 
 class noise_texture : public texture {
 public:
     noise_texture(double scale) : scale(scale) {}
 
-    color3 value(double u, double v, const point3& p) const override {
-        return color3(1, 1, 1) * (1 + std::sin(scale * p.z) + 10 * noise.turb(p, 7));
+    color3 value(double u, double v, const point3& p, const texture_footprint& footprint) const override {
+        double s = fast_math_mode() ? fast_sin(scale * p.z) : std::sin(scale * p.z);
+        // octaves finer than the footprint would only alias
+        return color3(1, 1, 1) * (1 + s + 10 * noise.turb(p, 7, footprint.world));
     }
+
+    texture_type type() const override { return texture_type::noise; }
 private:
     perlin noise;
     double scale;
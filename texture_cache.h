@@ -0,0 +1,428 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_TEXTURE_CACHE_H
+#define LUMINA_TEXTURE_CACHE_H
+
+#include <lumina_stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <climits>
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+// Image texels for all image textures of a process. Each file is decoded once, however many textures use
+// it, into a mip pyramid (each level half the size of the one above, down to 1x1) cut into square tiles
+// of tile_size texels. The tiles are written to a temporary backing file and read back on demand into a
+// fixed number of resident slots, so memory use stays within the budget however many textures a scene
+// has; when it is full, the least recently used tile is evicted. Tiles keep neighbouring texels together,
+// so lookups that are close in the image (most of them) stay within one small block of memory.
+//
+// Each thread also remembers the tile it used last in each shard and reads it without taking a lock, so
+// the locks are only taken when a thread's lookups move to another tile. A remembered tile is pinned: it
+// is not evicted until the thread moves on (or exits), so the budget can be exceeded by one tile per
+// shard per thread.
+//
+// open() is meant for scene construction and must not run concurrently with lookups; texel() may be
+// called from any number of render threads.
+
+struct texture_cache_stats {
+    size_t files = 0;
+    // tiles in all pyramids, and how many of them fit in the budget
+    uint64_t tiles = 0;
+    uint64_t resident_limit = 0;
+    // lookups of a thread's remembered tiles are added when it next takes a lock or exits, so a running
+    // thread's latest ones may be missing
+    uint64_t lookups = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t resident_bytes = 0;
+};
+
+class texture_cache {
+public:
+    static constexpr int tile_size = 32;
+    static constexpr size_t tile_bytes = size_t(tile_size) * tile_size * 3;
+    static constexpr size_t default_budget = size_t(256) << 20;
+
+    explicit texture_cache(size_t budget_bytes = default_budget) : backing(std::tmpfile()) {
+        set_budget(budget_bytes);
+        std::lock_guard<std::mutex> lock(live_mutex());
+        static uint64_t instances = 0;
+        instance = ++instances;
+        live_caches().push_back(this);
+    }
+
+    ~texture_cache() {
+        {
+            std::lock_guard<std::mutex> lock(live_mutex());
+            auto& live = live_caches();
+            live.erase(std::find(live.begin(), live.end(), this));
+        }
+        if (backing) std::fclose(backing);
+    }
+
+    texture_cache(const texture_cache&) = delete;
+    texture_cache& operator=(const texture_cache&) = delete;
+
+    // Memory for resident tiles, in bytes (at least one tile per shard). Takes effect for tiles loaded
+    // from now on, so set it before rendering.
+    void set_budget(size_t budget_bytes) {
+        size_t slots = std::max<size_t>(1, budget_bytes / tile_bytes / shard_count);
+        for (cache_shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.capacity = slots;
+        }
+    }
+
+    // Id of the image found for filename (see lumina_image::find), decoding it and building its pyramid if
+    // no earlier texture has; -1 (after printing the reason) if it cannot be loaded.
+    int open(const char* filename) {
+        std::string path = canonical_path(lumina_image::find(filename));
+        auto known = file_ids.find(path);
+        if (!path.empty() && known != file_ids.end()) return known->second;
+
+        lumina_image image;
+        if (path.empty() || !image.load(path)) {
+            std::cerr << "ERROR: Could not load image file '" << filename << "'.\n";
+            return -1;
+        }
+        std::unique_ptr<image_file> file(new image_file());
+        if (!write_pyramid(image, *file)) {
+            std::cerr << "ERROR: Could not store the tiles of image file '" << filename << "'.\n";
+            return -1;
+        }
+        for (cache_shard& shard : shards) shard.slot_of_tile.resize(size_t(tile_count / shard_count + 1), uint32_t(no_slot));
+        int id = int(files.size());
+        files.push_back(std::move(file));
+        file_ids.emplace(path, id);
+        return id;
+    }
+
+    int levels(int id) const { return int(files[id]->levels.size()); }
+    int width(int id, int level = 0) const { return files[id]->levels[level].width; }
+    int height(int id, int level = 0) const { return files[id]->levels[level].height; }
+
+    // Texel (x, y) of a level of image id, clamped to the edges, as three bytes.
+    void texel(int id, int level, int x, int y, unsigned char* rgb) {
+        const mip_level& mip = files[id]->levels[level];
+        x = x < 0 ? 0 : (x < mip.width ? x : mip.width - 1);
+        y = y < 0 ? 0 : (y < mip.height ? y : mip.height - 1);
+        uint64_t tile = mip.first_tile + uint64_t(y / tile_size) * mip.tiles_x + uint64_t(x / tile_size);
+        size_t offset = (size_t(y % tile_size) * tile_size + size_t(x % tile_size)) * 3;
+
+        thread_tiles& local = this_thread_tiles();
+        thread_tile& remembered = local.tiles[tile % shard_count];
+        const unsigned char* data;
+        if (remembered.tile == tile && remembered.instance == instance) {
+            data = remembered.data;
+            local.pending_lookups++;
+        } else {
+            data = remember_tile(local, remembered, tile);
+        }
+        rgb[0] = data[offset];
+        rgb[1] = data[offset + 1];
+        rgb[2] = data[offset + 2];
+    }
+
+    texture_cache_stats stats() {
+        texture_cache_stats result;
+        result.files = files.size();
+        result.tiles = tile_count;
+        for (cache_shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            result.resident_limit += shard.capacity;
+            result.lookups += shard.lookups;
+            result.misses += shard.misses;
+            result.evictions += shard.evictions;
+            result.resident_bytes += shard.data.size() * tile_bytes;
+        }
+        return result;
+    }
+
+private:
+    static constexpr int shard_count = 16;
+    static constexpr uint32_t no_slot = 0xFFFFFFFFu;
+
+    struct mip_level {
+        int width, height;
+        int tiles_x, tiles_y;
+        // tile number of the top-left tile in the backing file; tiles follow row by row
+        uint64_t first_tile;
+    };
+
+    struct image_file {
+        std::vector<mip_level> levels;
+    };
+
+    // Lookups lock one of several shards (chosen by tile number), so render threads rarely wait on each
+    // other. Each shard keeps its resident tiles in a doubly linked list, most recently used first.
+    struct cache_shard {
+        std::mutex mutex;
+        size_t capacity = 1;
+        // slot of each tile whose number is congruent to this shard (indexed by tile / shard_count), or no_slot
+        std::vector<uint32_t> slot_of_tile;
+        std::vector<std::unique_ptr<unsigned char[]>> data;
+        std::vector<uint64_t> tile_of_slot;
+        // number of threads remembering each slot's tile, which may then be neither evicted nor overwritten
+        std::vector<uint32_t> pins;
+        std::vector<uint32_t> previous, next;
+        uint32_t most_recent = no_slot, least_recent = no_slot;
+        uint64_t lookups = 0, misses = 0, evictions = 0;
+    };
+
+    // tells the tiles remembered for different caches apart
+    uint64_t instance;
+    std::FILE* backing;
+    // tiles of every level of every image, in the order they were written (used if no backing file)
+    std::vector<unsigned char> memory_backing;
+    // serialises reads of the backing file where pread is not available
+    std::mutex backing_mutex;
+    uint64_t tile_count = 0;
+    std::vector<std::unique_ptr<image_file>> files;
+    std::unordered_map<std::string, int> file_ids;
+    cache_shard shards[shard_count];
+
+    // the same file reached through different relative paths is still loaded once
+    static std::string canonical_path(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        char resolved[PATH_MAX];
+        if (!path.empty() && ::realpath(path.c_str(), resolved)) return resolved;
+#endif
+        return path;
+    }
+
+    bool write_pyramid(const lumina_image& image, image_file& file) {
+        // appended after the pyramids of earlier images
+        if (backing && std::fseek(backing, 0, SEEK_END) != 0) return false;
+        int w = image.width(), h = image.height();
+        std::vector<unsigned char> level(size_t(w) * h * 3);
+        for (int y = 0; y < h; y++) std::memcpy(&level[size_t(y) * w * 3], image.pixel_data(0, y), size_t(w) * 3);
+
+        std::vector<unsigned char> tile(tile_bytes);
+        while (true) {
+            mip_level mip;
+            mip.width = w;
+            mip.height = h;
+            mip.tiles_x = (w + tile_size - 1) / tile_size;
+            mip.tiles_y = (h + tile_size - 1) / tile_size;
+            mip.first_tile = tile_count;
+            file.levels.push_back(mip);
+            // edge tiles are padded by repeating the last row and column
+            for (int ty = 0; ty < mip.tiles_y; ty++) {
+                for (int tx = 0; tx < mip.tiles_x; tx++) {
+                    for (int y = 0; y < tile_size; y++) {
+                        int source_y = std::min(ty * tile_size + y, h - 1);
+                        for (int x = 0; x < tile_size; x++) {
+                            int source_x = std::min(tx * tile_size + x, w - 1);
+                            std::memcpy(&tile[(size_t(y) * tile_size + x) * 3], &level[(size_t(source_y) * w + source_x) * 3], 3);
+                        }
+                    }
+                    if (backing) {
+                        if (std::fwrite(tile.data(), 1, tile_bytes, backing) != tile_bytes) return false;
+                    } else {
+                        memory_backing.insert(memory_backing.end(), tile.begin(), tile.end());
+                    }
+                    tile_count++;
+                }
+            }
+            if (w == 1 && h == 1) break;
+
+            // box filter; an odd last row or column is averaged with itself
+            int next_w = std::max(1, w / 2), next_h = std::max(1, h / 2);
+            std::vector<unsigned char> next(size_t(next_w) * next_h * 3);
+            for (int y = 0; y < next_h; y++) {
+                int y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+                for (int x = 0; x < next_w; x++) {
+                    int x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+                    for (int c = 0; c < 3; c++) {
+                        int sum = level[(size_t(y0) * w + x0) * 3 + c] + level[(size_t(y0) * w + x1) * 3 + c]
+                                  + level[(size_t(y1) * w + x0) * 3 + c] + level[(size_t(y1) * w + x1) * 3 + c];
+                        next[(size_t(y) * next_w + x) * 3 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                    }
+                }
+            }
+            level.swap(next);
+            w = next_w;
+            h = next_h;
+        }
+        return !backing || std::fflush(backing) == 0;
+    }
+
+    // The tile a thread remembers for one shard of one cache (instance 0: none).
+    struct thread_tile {
+        uint64_t instance = 0;
+        uint64_t tile = 0;
+        uint32_t slot = 0;
+        const unsigned char* data = nullptr;
+    };
+
+    struct thread_tiles {
+        thread_tile tiles[shard_count];
+        // lookups of remembered tiles not yet added to the statistics of pending_instance
+        uint64_t pending_lookups = 0;
+        uint64_t pending_instance = 0;
+
+        // an exiting thread unpins its tiles in the caches that still exist
+        ~thread_tiles() {
+            std::lock_guard<std::mutex> lock(live_mutex());
+            for (int shard = 0; shard < shard_count; shard++) forget(tiles[shard], shard);
+            for (texture_cache* cache : live_caches()) {
+                if (cache->instance != pending_instance) continue;
+                std::lock_guard<std::mutex> shard_lock(cache->shards[0].mutex);
+                cache->shards[0].lookups += pending_lookups;
+            }
+        }
+    };
+
+    static std::mutex& live_mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<texture_cache*>& live_caches() {
+        static std::vector<texture_cache*> caches;
+        return caches;
+    }
+
+    static thread_tiles& this_thread_tiles() {
+        static thread_local thread_tiles tiles;
+        return tiles;
+    }
+
+    // Unpins a tile remembered for another cache, if that cache still exists. Called with live_mutex held
+    // and no shard locked.
+    static void forget(thread_tile& remembered, int shard) {
+        for (texture_cache* cache : live_caches()) {
+            if (cache->instance != remembered.instance) continue;
+            std::lock_guard<std::mutex> lock(cache->shards[shard].mutex);
+            cache->unpin(cache->shards[shard], remembered.slot);
+        }
+        remembered.instance = 0;
+    }
+
+    // Makes tile the one this thread remembers for its shard, in place of the one it remembered before.
+    const unsigned char* remember_tile(thread_tiles& local, thread_tile& remembered, uint64_t tile) {
+        int shard_index = int(tile % shard_count);
+        if (remembered.instance != 0 && remembered.instance != instance) {
+            std::lock_guard<std::mutex> lock(live_mutex());
+            forget(remembered, shard_index);
+        }
+
+        cache_shard& shard = shards[shard_index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (local.pending_instance == instance) shard.lookups += local.pending_lookups;
+        local.pending_lookups = 0;
+        local.pending_instance = instance;
+        if (remembered.instance == instance) unpin(shard, remembered.slot);
+        uint32_t slot = resident_slot(shard, tile);
+        shard.pins[slot]++;
+        remembered.instance = instance;
+        remembered.tile = tile;
+        remembered.slot = slot;
+        remembered.data = shard.data[slot].get();
+        return remembered.data;
+    }
+
+    // Called with the shard locked. The tile has just been in use, so it becomes the most recent.
+    void unpin(cache_shard& shard, uint32_t slot) {
+        shard.pins[slot]--;
+        if (slot != shard.most_recent) {
+            unlink(shard, slot);
+            push_front(shard, slot);
+        }
+    }
+
+    // Slot holding tile, loading it if it is not resident. Called with the shard locked.
+    uint32_t resident_slot(cache_shard& shard, uint64_t tile) {
+        shard.lookups++;
+        uint32_t& slot_of_tile = shard.slot_of_tile[tile / shard_count];
+        if (slot_of_tile != no_slot) {
+            uint32_t slot = slot_of_tile;
+            if (slot != shard.most_recent) {
+                unlink(shard, slot);
+                push_front(shard, slot);
+            }
+            return slot;
+        }
+
+        shard.misses++;
+        // the least recently used tile that no thread has pinned (at most one per thread is)
+        uint32_t slot = shard.least_recent;
+        while (slot != no_slot && shard.pins[slot] > 0) slot = shard.previous[slot];
+        if (shard.data.size() < shard.capacity || slot == no_slot) {
+            slot = uint32_t(shard.data.size());
+            shard.data.emplace_back(new unsigned char[tile_bytes]);
+            shard.tile_of_slot.push_back(tile);
+            shard.pins.push_back(0);
+            shard.previous.push_back(uint32_t(no_slot));
+            shard.next.push_back(uint32_t(no_slot));
+        } else {
+            shard.evictions++;
+            shard.slot_of_tile[shard.tile_of_slot[slot] / shard_count] = no_slot;
+            unlink(shard, slot);
+            shard.tile_of_slot[slot] = tile;
+        }
+        read_tile(tile, shard.data[slot].get());
+        slot_of_tile = slot;
+        push_front(shard, slot);
+        return slot;
+    }
+
+    void read_tile(uint64_t tile, unsigned char* data) {
+        if (!backing) {
+            std::memcpy(data, &memory_backing[tile * tile_bytes], tile_bytes);
+            return;
+        }
+#if defined(__unix__) || defined(__APPLE__)
+        // pread does not move a shared file position, so threads missing at the same time read in parallel
+        bool read = ::pread(fileno(backing), data, tile_bytes, off_t(tile * tile_bytes)) == ssize_t(tile_bytes);
+#else
+        std::lock_guard<std::mutex> lock(backing_mutex);
+        bool read = std::fseek(backing, long(tile * tile_bytes), SEEK_SET) == 0
+                    && std::fread(data, 1, tile_bytes, backing) == tile_bytes;
+#endif
+        if (!read) {
+            // cannot happen unless the temporary file is damaged; show the failure plainly
+            static const unsigned char magenta[] = { 255, 0, 255 };
+            for (size_t i = 0; i < tile_bytes; i += 3) std::memcpy(data + i, magenta, 3);
+        }
+    }
+
+    static void unlink(cache_shard& shard, uint32_t slot) {
+        uint32_t before = shard.previous[slot], after = shard.next[slot];
+        if (before != no_slot) shard.next[before] = after;
+        else shard.most_recent = after;
+        if (after != no_slot) shard.previous[after] = before;
+        else shard.least_recent = before;
+    }
+
+    static void push_front(cache_shard& shard, uint32_t slot) {
+        shard.previous[slot] = no_slot;
+        shard.next[slot] = shard.most_recent;
+        if (shard.most_recent != no_slot) shard.previous[shard.most_recent] = slot;
+        shard.most_recent = slot;
+        if (shard.least_recent == no_slot) shard.least_recent = slot;
+    }
+};
+
+// The cache shared by all image textures.
+inline texture_cache& shared_texture_cache() {
+    static texture_cache cache;
+    return cache;
+}
+
+#endif //LUMINA_TEXTURE_CACHE_H
@@ -0,0 +1,147 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_THREAD_POOL_H
+#define LUMINA_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that execute batches of indexed tasks. Each worker owns a deque of task
+// indices; it pops work from the front of its own deque and, once that runs dry, steals from the back of
+// another worker's deque. Tasks of very uneven cost (e.g. tiles covering glass spheres vs. tiles of sky)
+// therefore end up balanced without any up-front cost estimate.
+class thread_pool {
+public:
+    using task_function = std::function<void(size_t task_index, int worker_index)>;
+
+    explicit thread_pool(int thread_count = 0) {
+        if (thread_count <= 0) thread_count = default_thread_count();
+        queues.reserve(thread_count);
+        for (int i = 0; i < thread_count; i++) queues.emplace_back(new task_queue());
+        for (int i = 0; i < thread_count; i++) workers.emplace_back(&thread_pool::worker_loop, this, i);
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(batch_mutex);
+            shutting_down = true;
+        }
+        batch_started.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    static int default_thread_count() {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : static_cast<int>(n);
+    }
+
+    // Run task(0) ... task(task_count - 1) across the pool and block until all of them have finished.
+    // Tasks are dealt out to the workers in contiguous blocks so that neighbouring tiles start on the same
+    // thread; stealing takes over once a worker's block is exhausted.
+    void run(size_t task_count, const task_function& task) {
+        if (task_count == 0) return;
+
+        std::unique_lock<std::mutex> lock(batch_mutex);
+        // a worker that woke up too late for the previous batch may still be draining its (empty) queue
+        batch_finished.wait(lock, [this] { return active_workers == 0; });
+        size_t worker_count = queues.size();
+        for (size_t w = 0; w < worker_count; w++) {
+            size_t begin = task_count * w / worker_count;
+            size_t end = task_count * (w + 1) / worker_count;
+            std::lock_guard<std::mutex> queue_lock(queues[w]->mutex);
+            for (size_t t = begin; t < end; t++) queues[w]->tasks.push_back(t);
+        }
+
+        current_task = &task;
+        remaining_tasks = task_count;
+        batch_generation++;
+        batch_started.notify_all();
+
+        batch_finished.wait(lock, [this] { return remaining_tasks == 0 && active_workers == 0; });
+        current_task = nullptr;
+    }
+
+private:
+    struct task_queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex batch_mutex;
+    std::condition_variable batch_started;
+    std::condition_variable batch_finished;
+    const task_function* current_task = nullptr;
+    size_t remaining_tasks = 0;
+    int active_workers = 0;
+    unsigned long batch_generation = 0;
+    bool shutting_down = false;
+
+    bool pop_local(int worker_index, size_t& task_index) {
+        task_queue& queue = *queues[worker_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task_index = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int worker_index, size_t& task_index) {
+        // walk the other queues starting from our right-hand neighbour so that thieves spread out
+        int worker_count = static_cast<int>(queues.size());
+        for (int offset = 1; offset < worker_count; offset++) {
+            task_queue& victim = *queues[(worker_index + offset) % worker_count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task_index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(int worker_index) {
+        unsigned long seen_generation = 0;
+        while (true) {
+            const task_function* task;
+            {
+                std::unique_lock<std::mutex> lock(batch_mutex);
+                batch_started.wait(lock, [&] { return shutting_down || batch_generation != seen_generation; });
+                if (shutting_down) return;
+                seen_generation = batch_generation;
+                task = current_task;
+                active_workers++;
+            }
+
+            size_t task_index;
+            size_t completed = 0;
+            while (task && (pop_local(worker_index, task_index) || steal(worker_index, task_index))) {
+                (*task)(task_index, worker_index);
+                completed++;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(batch_mutex);
+                remaining_tasks -= completed;
+                active_workers--;
+                if (remaining_tasks == 0 && active_workers == 0) batch_finished.notify_all();
+            }
+        }
+    }
+};
+
+#endif //LUMINA_THREAD_POOL_H
@@ -11,10 +11,10 @@ using std::sqrt;
 
 class vec3 {
 public:
-    double x, y, z;
+    real x, y, z;
 
     vec3(): x(0), y(0), z(0) {}
-    vec3(double xx, double yy, double zz): x(xx), y(yy), z(zz) {}
+    vec3(real xx, real yy, real zz): x(xx), y(yy), z(zz) {}
 
     bool near_zero()    {
         const auto epsilon = 1e-8;
@@ -23,13 +23,13 @@ public:
 
     vec3 operator-() const { return vec3(-x, -y, -z); }
 
-    double operator[](int i) const {
+    real operator[](int i) const {
         if (i == 0) return x;
         if (i == 1) return y;
         if (i == 2) return z;
     }
 
-    double& operator[](int i) {
+    real& operator[](int i) {
         if (i == 0) return x;
         if (i == 1) return y;
         if (i == 2) return z;
@@ -48,29 +48,29 @@ public:
         z -= v.z;
         return *this;
     }
-    vec3& operator*=(const double t)   {
+    vec3& operator*=(const real t)   {
         x *= t;
         y *= t;
         z *= t;
         return *this;
     }
-    vec3& operator/=(const double t)   {
+    vec3& operator/=(const real t)   {
         x /= t;
         y /= t;
         z /= t;
         return *this;
     }
-    double length_squared() const  {
+    real length_squared() const  {
         return x*x + y*y + z*z;
     }
-    double length() const {
+    real length() const {
         return sqrt(length_squared());
     }
     inline static vec3 random() {
-        return {random_double(), random_double(), random_double()};
+        return {real(random_double()), real(random_double()), real(random_double())};
     }
-    inline static vec3 random(double min, double max)   {
-        return {random_double(min, max), random_double(min, max), random_double(min, max)};
+    inline static vec3 random(real min, real max)   {
+        return {real(random_double(min, max)), real(random_double(min, max)), real(random_double(min, max))};
     }
 };
 
@@ -95,19 +95,19 @@ inline vec3 operator*(const vec3 &u, const vec3 &v)    {
     return vec3(u.x*v.x, u.y*v.y, u.z*v.z);
 }
 
-inline vec3 operator*(const double t, const vec3& v)  {
+inline vec3 operator*(const real t, const vec3& v)  {
     return vec3(t*v.x, t*v.y, t*v.z);
 }
 
-inline vec3 operator*(const vec3 &v, const double t)    {
+inline vec3 operator*(const vec3 &v, const real t)    {
     return t * v;
 }
 
-inline vec3 operator/(const vec3 &v, const double t)  {
+inline vec3 operator/(const vec3 &v, const real t)  {
     return (1/t) * v;
 }
 
-inline double dot(const vec3 &u, const vec3 &v)   {
+inline real dot(const vec3 &u, const vec3 &v)   {
     return u.x*v.x + u.y*v.y + u.z*v.z;
 }
 
@@ -120,6 +120,7 @@ inline vec3 cross(const vec3 &u, const vec3 &v)    {
 }
 
 inline vec3 unit(const vec3 &v)  {
+    if (fast_math_mode()) return fast_rsqrt(v.length_squared()) * v;
     return v / v.length();
 }
 
@@ -147,7 +148,7 @@ vec3 reflect(const vec3& v, const vec3& n)  {
     return v - 2 * dot(v, n) * n;
 }
 
-vec3 refract(const vec3& uv, const vec3& n, const double etai_over_etar)    {
+vec3 refract(const vec3& uv, const vec3& n, const real etai_over_etar)    {
     auto cos_theta = fmin(dot(-uv, n), 1.0);
     vec3 r_out_perp = etai_over_etar * (uv + cos_theta * n);
     vec3 r_out_parallel = - sqrt(fabs(1.0 - dot(r_out_perp, r_out_perp))) * n;
@@ -0,0 +1,157 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_WAVEFRONT_H
+#define LUMINA_WAVEFRONT_H
+
+#include <lumina.h>
+#include <camera.h>
+#include <framebuffer.h>
+#include <hittable.h>
+#include <integrator.h>
+#include <material.h>
+#include <stats.h>
+
+#include <vector>
+
+// Stream (wavefront) version of path_color(). Instead of following one path to the end, a whole batch of
+// camera paths is advanced one bounce at a time: all rays of the wave are intersected, the hits are binned
+// by material and texture type, and each bin is shaded in one tight loop before the surviving paths form
+// the next wave. Traversal and each scatter() implementation thus run over many rays in a row, which keeps
+// their code and data hot in the caches.
+//
+// Random numbers are drawn from the same (pixel, sample, bounce) streams as path_color() and the results
+// are accumulated in sample order, so the output is identical to --integrator path.
+class wavefront_tracer {
+public:
+    explicit wavefront_tracer(size_t batch_size = 16384) : batch_size(batch_size) {}
+
+    // Trace samples [first_sample, end_sample) of every pixel of the framebuffer rectangle [x0, x1) x [y0, y1).
+    void render_tile(const hittable& world, const camera& cam, framebuffer& image,
+                     int x0, int y0, int x1, int y1, int first_sample, int end_sample) {
+        const int samples_per_pixel = end_sample - first_sample;
+        const int image_width = image.width();
+        const int image_height = image.height();
+        const size_t tile_width = size_t(x1 - x0);
+        const size_t total_paths = tile_width * size_t(y1 - y0) * samples_per_pixel;
+        random_stream& rng = thread_random_stream();
+
+        for (size_t first = 0; first < total_paths; first += batch_size) {
+            size_t count = std::min(batch_size, total_paths - first);
+
+            // generate the camera rays of this wave, pixel by pixel and sample by sample
+            paths.clear();
+            results.assign(count, color3(0, 0, 0));
+            for (size_t k = 0; k < count; k++) {
+                size_t path_index = first + k;
+                size_t local_pixel = path_index / samples_per_pixel;
+                int x = x0 + int(local_pixel % tile_width);
+                int y = y0 + int(local_pixel / tile_width);
+
+                wavefront_path path;
+                path.pixel = uint64_t(y) * image_width + x;
+                path.sample = uint32_t(first_sample + path_index % samples_per_pixel);
+                path.result = uint32_t(k);
+                path.depth = 0;
+                path.throughput = color3(1, 1, 1);
+                rng.seed(path.pixel, path.sample);
+                path.r = camera_sample_ray(cam, x, image_height - 1 - y, image_width, image_height);
+                paths.push_back(path);
+            }
+
+            while (!paths.empty()) trace_bounce(world);
+
+            for (size_t k = 0; k < count; k++) {
+                size_t local_pixel = (first + k) / samples_per_pixel;
+                image.pixel(x0 + int(local_pixel % tile_width), y0 + int(local_pixel / tile_width)).add(results[k]);
+            }
+        }
+    }
+
+private:
+    struct wavefront_path {
+        ray r;
+        color3 throughput;
+        uint64_t pixel;
+        uint32_t sample;
+        uint32_t result;
+        int depth;
+    };
+
+    static const int bin_count = int(material_type::count) * int(texture_type::count);
+
+    size_t batch_size;
+    std::vector<wavefront_path> paths;
+    std::vector<wavefront_path> next_paths;
+    std::vector<hit_record> records;
+    std::vector<int> bins;
+    std::vector<uint32_t> shading_order;
+    std::vector<color3> results;
+
+    static int shading_bin(const material& m) {
+        return int(m.type()) * int(texture_type::count) + int(m.surface_texture_type());
+    }
+
+    void trace_bounce(const hittable& world) {
+        const size_t count = paths.size();
+        records.resize(count);
+        bins.resize(count);
+
+        // 1. intersect the whole wave; misses pick up the sky and leave the wave
+        size_t bin_sizes[bin_count + 1] = {};
+        for (size_t k = 0; k < count; k++) {
+            wavefront_path& path = paths[k];
+            // Use t_min = 0.001 to avoid shadow acne issues
+            LUMINA_COUNT(rays);
+            if (closest_hit(world, path.r, interval(0.001, infinity), records[k])) {
+                bins[k] = shading_bin(*records[k].material_ptr);
+                bin_sizes[bins[k] + 1]++;
+            } else {
+                results[path.result] = path.throughput * background_color(path.r);
+                bins[k] = -1;
+                LUMINA_COUNT(path_lengths[path_length_bin(path.depth + 1)]);
+            }
+        }
+
+        // 2. counting sort of the hits by shading bin
+        for (int b = 0; b < bin_count; b++) bin_sizes[b + 1] += bin_sizes[b];
+        shading_order.resize(bin_sizes[bin_count]);
+        for (size_t k = 0; k < count; k++) {
+            if (bins[k] >= 0) shading_order[bin_sizes[bins[k]]++] = uint32_t(k);
+        }
+
+        // 3. shade bin after bin; survivors form the next wave
+        random_stream& rng = thread_random_stream();
+        next_paths.clear();
+        ray scattered;
+        color3 attenuation;
+        for (uint32_t k : shading_order) {
+            wavefront_path path = paths[k];
+            const hit_record& hit_rec = records[k];
+            rng.seed(path.pixel, path.sample, path.depth + 1);
+            LUMINA_COUNT(scatter_calls[int(hit_rec.material_ptr->type())]);
+            if (!hit_rec.material_ptr->scatter(path.r, hit_rec, attenuation, scattered)) {
+                LUMINA_COUNT(path_lengths[path_length_bin(path.depth + 1)]);
+                continue;
+            }
+            path.throughput = path.throughput * attenuation;
+
+            if (path.depth >= roulette_start_depth) {
+                // Russian roulette, exactly as in path_color()
+                double q = roulette_continue_probability(path.throughput);
+                if (rng.next_double() >= q) {
+                    LUMINA_COUNT(path_lengths[path_length_bin(path.depth + 1)]);
+                    continue;
+                }
+                path.throughput /= q;
+            }
+            path.r = scattered;
+            path.depth++;
+            next_paths.push_back(path);
+        }
+        paths.swap(next_paths);
+    }
+};
+
+#endif //LUMINA_WAVEFRONT_H
@@ -0,0 +1,306 @@
+//
+// Created by Anchit Mishra on 2026-10-18.
+//
+
+#ifndef LUMINA_WIDE_BVH_H
+#define LUMINA_WIDE_BVH_H
+
+#include <lumina.h>
+#include <aabb.h>
+#include <bvh.h>
+#include <hittable.h>
+#include <hittable_list.h>
+#include <linear_bvh.h>
+#include <stats.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Node of a W-wide BVH. The bounds of all W children are stored structure-of-arrays style, so that one
+// vector instruction can run the same slab-test step for every child at once.
+template <int W>
+struct wide_bvh_node {
+    // bounds[0] holds the minimum corners, bounds[1] the maximum corners: bounds[corner][axis][child]
+    float bounds[2][3][W];
+    // interior child: index of the child node; leaf child: first primitive; unused slot: -1
+    int32_t child[W];
+    // number of primitives of a leaf child, 0 for interior children and unused slots
+    uint16_t primitive_count[W];
+};
+
+// W-wide BVH (W = 4 or 8) collapsed from a binary linear_bvh. Each wide node replaces a binary subtree of
+// up to W - 1 interior nodes, so traversal goes roughly half (W = 4) or a third (W = 8) as deep, and the
+// W box tests of a node run as one SIMD slab test: SSE for W = 4, AVX for W = 8 when the compiler targets
+// it (see LUMINA_AVX2 in CMakeLists.txt). A scalar loop is used otherwise.
+template <int W>
+class wide_bvh : public hittable {
+    static_assert(W == 4 || W == 8, "wide_bvh supports 4- and 8-wide nodes");
+
+public:
+    wide_bvh(const hittable_list& list, const bvh_build_options& options = bvh_build_options())
+        : binary(list, options) {
+        const auto& binary_nodes = binary.node_array();
+        if (binary_nodes.empty()) return;
+        if (binary_nodes[0].primitive_count > 0) {
+            // a single leaf: give the wide root one child
+            nodes.emplace_back();
+            clear_node(nodes[0]);
+            set_child(nodes[0], 0, binary_nodes[0], 0);
+            return;
+        }
+        collapse(0);
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (nodes.empty()) return false;
+
+        ray_constants rc;
+        rc.origin[0] = float(r.origin.x);
+        rc.origin[1] = float(r.origin.y);
+        rc.origin[2] = float(r.origin.z);
+        double direction[3] = { r.direction.x, r.direction.y, r.direction.z };
+        for (int axis = 0; axis < 3; axis++) {
+            rc.inverse_direction[axis] = float(1.0 / direction[axis]);
+            // the near plane of a box is its minimum corner for positive directions and its maximum otherwise
+            rc.near_corner[axis] = rc.inverse_direction[axis] < 0 ? 1 : 0;
+        }
+
+        struct stack_entry {
+            int32_t index;
+            uint16_t primitive_count;
+            float t_near;
+        };
+        stack_entry stack[64 * W];
+        int stack_size = 0;
+        stack[stack_size++] = { 0, 0, float(ray_t.min) };
+        bool hit_anything = false;
+
+        while (stack_size > 0) {
+            stack_entry entry = stack[--stack_size];
+            // skip subtrees whose box starts beyond the closest hit found since they were pushed
+            if (entry.t_near > ray_t.max) continue;
+
+            if (entry.primitive_count > 0) {
+                const hittable* const* first = &binary.primitive_array()[entry.index];
+                for (int i = 0; i < entry.primitive_count; i++) {
+                    if (first[i]->hit(r, ray_t, rec)) {
+                        hit_anything = true;
+                        ray_t.max = rec.root;
+                    }
+                }
+                continue;
+            }
+
+            LUMINA_COUNT(bvh_nodes_visited);
+            LUMINA_COUNT_N(aabb_tests, W);
+            const wide_bvh_node<W>& node = nodes[entry.index];
+            float t_near[W];
+            int mask = intersect_children(node, rc, float(ray_t.min), float(ray_t.max), t_near);
+
+            // push the hit children far to near, so that the nearest is popped first
+            int order[W];
+            int hit_count = 0;
+            for (int i = 0; i < W; i++) {
+                if (!(mask & (1 << i)) || node.child[i] < 0) continue;
+                int j = hit_count++;
+                while (j > 0 && t_near[order[j - 1]] < t_near[i]) {
+                    order[j] = order[j - 1];
+                    j--;
+                }
+                order[j] = i;
+            }
+            for (int k = 0; k < hit_count; k++) {
+                int i = order[k];
+                stack[stack_size++] = { node.child[i], node.primitive_count[i], t_near[i] };
+            }
+        }
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return binary.bounding_box(); }
+
+    size_t node_count() const { return nodes.size(); }
+    size_t memory_bytes() const { return nodes.size() * sizeof(wide_bvh_node<W>); }
+
+    bvh_tree_stats stats() const {
+        // tree shape of the wide tree; the SAH cost is that of the binary tree it was collapsed from
+        bvh_tree_stats result = binary.stats();
+        result.interior_nodes = nodes.size();
+        result.max_depth = nodes.empty() ? 0 : depth(0);
+        return result;
+    }
+
+private:
+    struct ray_constants {
+        float origin[3];
+        float inverse_direction[3];
+        int near_corner[3];
+    };
+
+    linear_bvh binary;
+    std::vector<wide_bvh_node<W>> nodes;
+
+    static void clear_node(wide_bvh_node<W>& node) {
+        for (int i = 0; i < W; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                // unused slots are skipped through child == -1; their bounds never matter
+                node.bounds[0][axis][i] = std::numeric_limits<float>::quiet_NaN();
+                node.bounds[1][axis][i] = std::numeric_limits<float>::quiet_NaN();
+            }
+            node.child[i] = -1;
+            node.primitive_count[i] = 0;
+        }
+    }
+
+    static void set_child(wide_bvh_node<W>& node, int slot, const linear_bvh_node& source, int32_t child_index) {
+        for (int axis = 0; axis < 3; axis++) {
+            node.bounds[0][axis][slot] = source.bounds_min[axis];
+            node.bounds[1][axis][slot] = source.bounds_max[axis];
+        }
+        node.child[slot] = source.primitive_count > 0 ? int32_t(source.offset) : child_index;
+        node.primitive_count[slot] = source.primitive_count;
+    }
+
+    static double area(const linear_bvh_node& node) {
+        double dx = node.bounds_max[0] - node.bounds_min[0];
+        double dy = node.bounds_max[1] - node.bounds_min[1];
+        double dz = node.bounds_max[2] - node.bounds_min[2];
+        return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    // Collapse the binary subtree rooted at interior node `binary_index` into a wide node, recursively.
+    int32_t collapse(uint32_t binary_index) {
+        const auto& binary_nodes = binary.node_array();
+
+        // start from the two children and keep opening the largest interior child until W slots are used
+        std::vector<uint32_t> children = { binary_index + 1, binary_nodes[binary_index].offset };
+        while (int(children.size()) < W) {
+            int largest = -1;
+            for (int i = 0; i < int(children.size()); i++) {
+                const linear_bvh_node& candidate = binary_nodes[children[i]];
+                if (candidate.primitive_count > 0) continue;
+                if (largest < 0 || area(candidate) > area(binary_nodes[children[largest]])) largest = i;
+            }
+            if (largest < 0) break;
+            uint32_t opened = children[largest];
+            children[largest] = opened + 1;
+            children.insert(children.begin() + largest + 1, binary_nodes[opened].offset);
+        }
+
+        int32_t node_index = int32_t(nodes.size());
+        nodes.emplace_back();
+        clear_node(nodes[node_index]);
+        for (int slot = 0; slot < int(children.size()); slot++) {
+            const linear_bvh_node& source = binary_nodes[children[slot]];
+            int32_t child_index = source.primitive_count > 0 ? 0 : collapse(children[slot]);
+            set_child(nodes[node_index], slot, source, child_index);
+        }
+        return node_index;
+    }
+
+    int depth(int32_t node_index) const {
+        int deepest = 0;
+        const wide_bvh_node<W>& node = nodes[node_index];
+        for (int i = 0; i < W; i++) {
+            if (node.child[i] >= 0 && node.primitive_count[i] == 0) deepest = std::max(deepest, depth(node.child[i]));
+        }
+        return deepest + 1;
+    }
+
+    // Slab test of the ray against all W child boxes. Returns a bit mask of the children that are hit and
+    // stores their entry distances in t_near.
+    static int intersect_children(const wide_bvh_node<W>& node, const ray_constants& rc, float t_min, float t_max,
+                                  float* t_near);
+};
+
+// far distances are widened by a few ulps to make up for float rounding, as in linear_bvh
+const float wide_bvh_far_scale = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+template <int W>
+inline int wide_bvh_intersect_scalar(const wide_bvh_node<W>& node, const float* origin, const float* inverse_direction,
+                                     const int* near_corner, float t_min, float t_max, float* t_near) {
+    int mask = 0;
+    for (int i = 0; i < W; i++) {
+        float t0 = t_min, t1 = t_max;
+        for (int axis = 0; axis < 3; axis++) {
+            float near_t = (node.bounds[near_corner[axis]][axis][i] - origin[axis]) * inverse_direction[axis];
+            float far_t = (node.bounds[1 - near_corner[axis]][axis][i] - origin[axis]) * inverse_direction[axis];
+            far_t *= wide_bvh_far_scale;
+            // a NaN slab (ray parallel to and in the plane of a face) leaves the interval unchanged
+            t0 = near_t > t0 ? near_t : t0;
+            t1 = far_t < t1 ? far_t : t1;
+        }
+        t_near[i] = t0;
+        if (t0 <= t1) mask |= 1 << i;
+    }
+    return mask;
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+template <>
+inline int wide_bvh<4>::intersect_children(const wide_bvh_node<4>& node, const ray_constants& rc, float t_min,
+                                           float t_max, float* t_near) {
+    __m128 t0 = _mm_set1_ps(t_min);
+    __m128 t1 = _mm_set1_ps(t_max);
+    const __m128 far_scale = _mm_set1_ps(wide_bvh_far_scale);
+    for (int axis = 0; axis < 3; axis++) {
+        __m128 origin = _mm_set1_ps(rc.origin[axis]);
+        __m128 inverse_direction = _mm_set1_ps(rc.inverse_direction[axis]);
+        __m128 near_plane = _mm_loadu_ps(node.bounds[rc.near_corner[axis]][axis]);
+        __m128 far_plane = _mm_loadu_ps(node.bounds[1 - rc.near_corner[axis]][axis]);
+        __m128 near_t = _mm_mul_ps(_mm_sub_ps(near_plane, origin), inverse_direction);
+        __m128 far_t = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(far_plane, origin), inverse_direction), far_scale);
+        // operand order matters: maxps/minps return the second operand if either one is NaN, so a NaN slab
+        // leaves the interval unchanged just like the scalar version
+        t0 = _mm_max_ps(near_t, t0);
+        t1 = _mm_min_ps(far_t, t1);
+    }
+    _mm_storeu_ps(t_near, t0);
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+}
+#else
+template <>
+inline int wide_bvh<4>::intersect_children(const wide_bvh_node<4>& node, const ray_constants& rc, float t_min,
+                                           float t_max, float* t_near) {
+    return wide_bvh_intersect_scalar<4>(node, rc.origin, rc.inverse_direction, rc.near_corner, t_min, t_max, t_near);
+}
+#endif
+
+#if defined(__AVX__)
+template <>
+inline int wide_bvh<8>::intersect_children(const wide_bvh_node<8>& node, const ray_constants& rc, float t_min,
+                                           float t_max, float* t_near) {
+    __m256 t0 = _mm256_set1_ps(t_min);
+    __m256 t1 = _mm256_set1_ps(t_max);
+    const __m256 far_scale = _mm256_set1_ps(wide_bvh_far_scale);
+    for (int axis = 0; axis < 3; axis++) {
+        __m256 origin = _mm256_set1_ps(rc.origin[axis]);
+        __m256 inverse_direction = _mm256_set1_ps(rc.inverse_direction[axis]);
+        __m256 near_plane = _mm256_loadu_ps(node.bounds[rc.near_corner[axis]][axis]);
+        __m256 far_plane = _mm256_loadu_ps(node.bounds[1 - rc.near_corner[axis]][axis]);
+        __m256 near_t = _mm256_mul_ps(_mm256_sub_ps(near_plane, origin), inverse_direction);
+        __m256 far_t = _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(far_plane, origin), inverse_direction), far_scale);
+        t0 = _mm256_max_ps(near_t, t0);
+        t1 = _mm256_min_ps(far_t, t1);
+    }
+    _mm256_storeu_ps(t_near, t0);
+    return _mm256_movemask_ps(_mm256_cmp_ps(t0, t1, _CMP_LE_OQ));
+}
+#else
+template <>
+inline int wide_bvh<8>::intersect_children(const wide_bvh_node<8>& node, const ray_constants& rc, float t_min,
+                                           float t_max, float* t_near) {
+    return wide_bvh_intersect_scalar<8>(node, rc.origin, rc.inverse_direction, rc.near_corner, t_min, t_max, t_near);
+}
+#endif
+
+using bvh4 = wide_bvh<4>;
+using bvh8 = wide_bvh<8>;
+
+#endif //LUMINA_WIDE_BVH_H